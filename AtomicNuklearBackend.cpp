@@ -0,0 +1,286 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Rokas Kupstys
+ * Copyright (c) 2008-2016 the Urho3D project.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <Atomic/Core/Context.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Graphics/Graphics.h>
+#include "AtomicNuklearBackend.h"
+
+namespace Atomic
+{
+
+NuklearGraphicsBackend::NuklearGraphicsBackend(Graphics* graphics)
+    : _graphics(graphics)
+{
+    _vertex_buffer = new VertexBuffer(graphics->GetContext());
+    _index_buffer = new IndexBuffer(graphics->GetContext());
+
+    _vs_color = graphics->GetShader(VS, "Basic", "VERTEXCOLOR");
+    _ps_color = graphics->GetShader(PS, "Basic", "VERTEXCOLOR");
+    _vs_diffmap = graphics->GetShader(VS, "Basic", "DIFFMAP VERTEXCOLOR");
+    _ps_diffmap = graphics->GetShader(PS, "Basic", "DIFFMAP VERTEXCOLOR");
+    _ps_alphamap = graphics->GetShader(PS, "Basic", "ALPHAMAP VERTEXCOLOR");
+    // Shipped with NuklearUI, null when its Data directory is not a resource path.
+    _vs_packed_color = graphics->GetShader(VS, "NuklearPacked", "VERTEXCOLOR");
+    _vs_packed_diffmap = graphics->GetShader(VS, "NuklearPacked", "DIFFMAP VERTEXCOLOR");
+    _ps_premul_color = graphics->GetShader(PS, "NuklearPremul", "VERTEXCOLOR");
+    _ps_premul_diffmap = graphics->GetShader(PS, "NuklearPremul", "DIFFMAP VERTEXCOLOR");
+    _ps_premul_alphamap = graphics->GetShader(PS, "NuklearPremul", "ALPHAMAP VERTEXCOLOR");
+}
+
+void NuklearGraphicsBackend::ResizeBuffers(unsigned vertex_count, const PODVector<VertexElement>& elements,
+                                           unsigned index_count)
+{
+    if (vertex_count)
+    {
+        _vertex_buffer->SetSize(vertex_count, elements, true);
+        _packed = elements[0].type_ == TYPE_UBYTE4;
+    }
+    if (index_count)
+        _index_buffer->SetSize(index_count, sizeof(nk_draw_index) > 2, true);
+}
+
+bool NuklearGraphicsBackend::Lock(void*& vertices, unsigned vertex_count, void*& indices, unsigned index_count)
+{
+    vertices = _vertex_buffer->Lock(0, vertex_count, true);
+    indices = _index_buffer->Lock(0, index_count, true);
+    return vertices && indices;
+}
+
+void NuklearGraphicsBackend::Unlock()
+{
+    _vertex_buffer->Unlock();
+    _index_buffer->Unlock();
+}
+
+bool NuklearGraphicsBackend::CheckDataLost()
+{
+    // Device loss discards contents of dynamic buffers.
+    if (!_vertex_buffer->IsDataLost() && !_index_buffer->IsDataLost())
+        return false;
+    _vertex_buffer->ClearDataLost();
+    _index_buffer->ClearDataLost();
+    return true;
+}
+
+IntVector2 NuklearGraphicsBackend::GetSize() const
+{
+    // Ui is drawn to the backbuffer, viewport of last rendered view may be smaller.
+    return IntVector2(_graphics->GetWidth(), _graphics->GetHeight());
+}
+
+void NuklearGraphicsBackend::SetRenderTarget(Texture2D* target)
+{
+    _target_active = target != 0;
+    if (target)
+    {
+        _graphics->SetRenderTarget(0, target);
+        _graphics->SetDepthStencil((RenderSurface*)0);
+        _graphics->SetViewport(IntRect(0, 0, target->GetWidth(), target->GetHeight()));
+        _graphics->Clear(CLEAR_COLOR, Color(0.0f, 0.0f, 0.0f, 0.0f));
+    }
+    else
+    {
+        _graphics->ResetRenderTargets();
+        _graphics->SetViewport(IntRect(0, 0, _graphics->GetWidth(), _graphics->GetHeight()));
+    }
+}
+
+bool NuklearGraphicsBackend::SupportsBaseVertex() const
+{
+#ifdef ATOMIC_OPENGL
+    // Graphics drops base vertex draws when glDrawElementsBaseVertex is missing, as on OpenGL 2 and OpenGL ES.
+    return Graphics::GetGL3Support();
+#else
+    return true;
+#endif
+}
+
+bool NuklearGraphicsBackend::SupportsPackedVertices() const
+{
+    return _vs_packed_color && _vs_packed_diffmap;
+}
+
+void NuklearGraphicsBackend::Submit(const PODVector<NuklearDrawCommand>& commands, unsigned vertex_count,
+                                    const Matrix4& projection, NuklearUIStats& stats)
+{
+    if (commands.Empty())
+        return;
+
+    _graphics->ClearParameterSources();
+    _graphics->SetColorWrite(true);
+    _graphics->SetCullMode(CULL_NONE);
+    _graphics->SetDepthTest(CMP_ALWAYS);
+    _graphics->SetDepthWrite(false);
+    _graphics->SetFillMode(FILL_SOLID);
+    _graphics->SetStencilTest(false);
+    _graphics->SetVertexBuffer(_vertex_buffer);
+    _graphics->SetIndexBuffer(_index_buffer);
+
+    float elapsedTime = _graphics->GetSubsystem<Time>()->GetElapsedTime();
+    ShaderVariation* current_vs = 0;
+    ShaderVariation* current_ps = 0;
+    Texture2D* current_texture = 0;
+    IntRect current_scissor = IntRect::ZERO;
+    BlendMode current_blend = BLEND_ALPHA;
+    bool first = true;
+
+    // Render targets accumulate premultiplied color and correct coverage, so that they are blended only once when
+    // drawn. Without premultiplying shaders they are rendered and drawn like any other geometry.
+    bool premul_shaders = _ps_premul_color && _ps_premul_diffmap && _ps_premul_alphamap;
+    bool premultiply = premul_shaders && _target_active;
+    for (const NuklearDrawCommand& cmd : commands)
+    {
+        ShaderVariation* ps;
+        ShaderVariation* vs;
+
+        Texture2D* texture = cmd.texture;
+        if (!texture)
+        {
+            ps = premultiply ? _ps_premul_color : _ps_color;
+            vs = _packed ? _vs_packed_color : _vs_color;
+        }
+        else
+        {
+            // If texture contains only an alpha channel, use alpha shader (for fonts)
+            vs = _packed ? _vs_packed_diffmap : _vs_diffmap;
+            if (texture->GetFormat() == Graphics::GetAlphaFormat())
+                ps = premultiply ? _ps_premul_alphamap : _ps_alphamap;
+            else
+                ps = premultiply ? _ps_premul_diffmap : _ps_diffmap;
+        }
+
+        BlendMode blend = premultiply || (premul_shaders && cmd.premultiplied) ? BLEND_PREMULALPHA : BLEND_ALPHA;
+        if (first || blend != current_blend)
+        {
+            _graphics->SetBlendMode(blend);
+            // Blend mode is set once per submission, only switches are state changes.
+            if (!first)
+                stats.state_changes++;
+            current_blend = blend;
+        }
+
+        if (first || vs != current_vs || ps != current_ps)
+        {
+            _graphics->SetShaders(vs, ps);
+            if (_graphics->NeedParameterUpdate(SP_OBJECT, this))
+                _graphics->SetShaderParameter(VSP_MODEL, Matrix3x4::IDENTITY);
+            if (_graphics->NeedParameterUpdate(SP_CAMERA, this))
+                _graphics->SetShaderParameter(VSP_VIEWPROJ, projection);
+            if (_graphics->NeedParameterUpdate(SP_MATERIAL, this))
+                _graphics->SetShaderParameter(PSP_MATDIFFCOLOR, Color(1.0f, 1.0f, 1.0f, 1.0f));
+            _graphics->SetShaderParameter(VSP_ELAPSEDTIME, elapsedTime);
+            _graphics->SetShaderParameter(PSP_ELAPSEDTIME, elapsedTime);
+            current_vs = vs;
+            current_ps = ps;
+            stats.state_changes++;
+        }
+        if (first || texture != current_texture)
+        {
+            _graphics->SetTexture(0, texture);
+            current_texture = texture;
+            stats.state_changes++;
+        }
+        if (first || cmd.scissor != current_scissor)
+        {
+            _graphics->SetScissorTest(true, cmd.scissor);
+            current_scissor = cmd.scissor;
+            stats.state_changes++;
+        }
+        first = false;
+
+        _graphics->Draw(TRIANGLE_LIST, cmd.index_start, cmd.index_count, cmd.vertex_start, 0,
+                        vertex_count - cmd.vertex_start);
+        stats.draw_calls++;
+    }
+
+    _graphics->SetScissorTest(false);
+}
+
+NuklearNullBackend::NuklearNullBackend(const IntVector2& size)
+    : _size(size)
+{
+}
+
+void NuklearNullBackend::ResizeBuffers(unsigned vertex_count, const PODVector<VertexElement>& elements,
+                                       unsigned index_count)
+{
+    if (vertex_count)
+    {
+        _vertex_size = VertexBuffer::GetVertexSize(elements);
+        _vertex_capacity = vertex_count;
+        _vertex_data.Resize(vertex_count * _vertex_size);
+    }
+    if (index_count)
+    {
+        _index_capacity = index_count;
+        _index_data.Resize(index_count * (unsigned)sizeof(nk_draw_index));
+    }
+}
+
+bool NuklearNullBackend::Lock(void*& vertices, unsigned vertex_count, void*& indices, unsigned index_count)
+{
+    // Memory is not uploaded anywhere, mapped range does not matter.
+    (void)vertex_count;
+    (void)index_count;
+    vertices = _vertex_data.Empty() ? 0 : &_vertex_data.Front();
+    indices = _index_data.Empty() ? 0 : &_index_data.Front();
+    return vertices && indices;
+}
+
+void NuklearNullBackend::Submit(const PODVector<NuklearDrawCommand>& commands, unsigned vertex_count,
+                                const Matrix4& projection, NuklearUIStats& stats)
+{
+    _submitted_commands = commands;
+    _submitted_vertices = vertex_count;
+    _submitted_projection = projection;
+    _submit_count++;
+
+    // Count state changes the way graphics backend issues them. Shaders differ for untextured, RGBA and alpha textures,
+    // blend mode differs for premultiplied textures.
+    stats.draw_calls += commands.Size();
+    unsigned prev_shaders = 0;
+    for (unsigned i = 0; i < commands.Size(); i++)
+    {
+        Texture2D* texture = commands[i].texture;
+        unsigned shaders = !texture ? 0 : texture->GetFormat() == Graphics::GetAlphaFormat() ? 2 : 1;
+        if (i == 0)
+            stats.state_changes += 3;
+        else
+        {
+            const NuklearDrawCommand& prev = commands[i - 1];
+            if (shaders != prev_shaders)
+                stats.state_changes++;
+            if (prev.premultiplied != commands[i].premultiplied)
+                stats.state_changes++;
+            if (prev.texture != texture)
+                stats.state_changes++;
+            if (prev.scissor != commands[i].scissor)
+                stats.state_changes++;
+        }
+        prev_shaders = shaders;
+    }
+}
+
+}
@@ -0,0 +1,262 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Rokas Kupstys
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+
+#include <Atomic/Container/RefCounted.h>
+#include <Atomic/Graphics/VertexBuffer.h>
+#include <Atomic/Graphics/IndexBuffer.h>
+#include <Atomic/Graphics/Texture2D.h>
+#include <Atomic/Graphics/ShaderVariation.h>
+#include <Atomic/Math/Matrix4.h>
+#include "nuklear/nuklear.h"
+
+namespace Atomic
+{
+
+/// Statistics of NuklearUI rendering. Frame cache counters are accumulated since subsystem creation, other values
+/// describe last rendered frame.
+struct NuklearUIStats
+{
+    /// Number of frames that reused geometry uploaded in previous frame.
+    unsigned frame_cache_hits = 0;
+    /// Number of frames that had to be converted and uploaded.
+    unsigned frame_cache_misses = 0;
+    /// Number of draw commands produced by nuklear.
+    unsigned nk_draw_commands = 0;
+    /// Number of draw commands skipped because of empty or off-screen scissor.
+    unsigned culled_commands = 0;
+    /// Number of issued draw calls.
+    unsigned draw_calls = 0;
+    /// Number of cached windows redrawn into their textures.
+    unsigned window_redraws = 0;
+    /// Number of command segments tessellated in parallel.
+    unsigned parallel_segments = 0;
+    /// Number of window segments whose geometry was reused from previous frame.
+    unsigned retained_segments = 0;
+    /// Tessellation quality level chosen by budget governor, 0 is the best.
+    unsigned quality_level = 0;
+    /// Number of shader, blend mode, texture and scissor changes.
+    unsigned state_changes = 0;
+    /// Number of vertices drawn.
+    unsigned vertex_count = 0;
+    /// Number of vertex chunks addressed by 16-bit indices with separate base vertex. 1 when geometry fits in one.
+    unsigned vertex_chunks = 0;
+    /// True if geometry uses 32-bit indices and is never chunked.
+    bool large_indices = false;
+    /// True if vertices were uploaded in packed 12 byte format.
+    bool packed_vertices = false;
+    /// Bytes of geometry buffers mapped for writing during the frame.
+    unsigned upload_bytes = 0;
+    /// Number of indices drawn.
+    unsigned index_count = 0;
+    /// Time spent in E_NUKLEARFRAME handlers building the UI, in microseconds.
+    unsigned frame_time_us = 0;
+    /// Time spent converting nuklear commands into vertex and index buffers, in microseconds. Includes lock time.
+    unsigned convert_time_us = 0;
+    /// Time spent locking and unlocking geometry buffers, which is where geometry upload happens, in microseconds.
+    unsigned lock_time_us = 0;
+    /// Time spent building draw commands from converted draw list, in microseconds.
+    unsigned record_time_us = 0;
+    /// Time spent uploading glyphs of dynamic fonts, in microseconds.
+    unsigned glyph_upload_time_us = 0;
+    /// Time spent submitting draw commands, in microseconds.
+    unsigned submit_time_us = 0;
+    /// Vertex buffer capacity.
+    unsigned vertex_capacity = 0;
+    /// Index buffer capacity.
+    unsigned index_capacity = 0;
+    /// Number of geometry buffer reallocations since subsystem creation.
+    unsigned buffer_reallocations = 0;
+    /// Font atlas texture width.
+    unsigned atlas_width = 0;
+    /// Font atlas texture height.
+    unsigned atlas_height = 0;
+    /// Number of raw input events received during the frame.
+    unsigned input_events = 0;
+    /// Number of raw input events consumed by the UI during the frame.
+    unsigned input_events_consumed = 0;
+    /// Number of motion and wheel events merged into a following one during the frame.
+    unsigned input_events_coalesced = 0;
+    /// Bytes of nuklear context memory used by last frame.
+    unsigned frame_memory_used = 0;
+    /// Peak bytes of nuklear context memory used by a single frame.
+    unsigned frame_memory_peak = 0;
+    /// Number of frames that did not fit into fixed context memory budget.
+    unsigned frame_memory_overflows = 0;
+    /// Peak bytes of draw command memory.
+    unsigned command_memory_peak = 0;
+    /// Number of frames that did not fit into fixed draw command memory budget.
+    unsigned command_memory_overflows = 0;
+    /// Bytes allocated from atlas arena.
+    unsigned atlas_memory_used = 0;
+    /// Number of atlas allocations that did not fit into atlas arena and went to heap.
+    unsigned atlas_memory_overflows = 0;
+};
+
+/// Draw call recorded from nuklear draw list. Adjacent nuklear draw commands sharing texture and scissor are merged.
+struct NuklearDrawCommand
+{
+    /// Texture, null for untextured geometry.
+    Atomic::Texture2D* texture;
+    /// Scissor rectangle in pixels, clipped to viewport.
+    Atomic::IntRect scissor;
+    /// First index in index buffer.
+    unsigned index_start;
+    /// Number of indices.
+    unsigned index_count;
+    /// Vertex added to every index, selects vertex chunk that 16-bit indices address.
+    unsigned vertex_start;
+    /// Texture holds premultiplied alpha, as textures of cached windows do.
+    bool premultiplied;
+};
+
+/// Submission stage of NuklearUI. Owns buffers that nuklear geometry is converted into and draws recorded commands.
+class NuklearRenderBackend
+    : public Atomic::RefCounted
+{
+public:
+    virtual ~NuklearRenderBackend() { }
+
+    /// Resize geometry buffers. Count of 0 keeps current size of that buffer. Contents are discarded.
+    virtual void ResizeBuffers(unsigned vertex_count, const Atomic::PODVector<Atomic::VertexElement>& elements,
+                               unsigned index_count) = 0;
+    /// Get number of vertices vertex buffer can hold.
+    virtual unsigned GetVertexCapacity() const = 0;
+    /// Get number of indices index buffer can hold.
+    virtual unsigned GetIndexCapacity() const = 0;
+    /// Map first vertex_count vertices and index_count indices of geometry buffers for writing, discarding previous
+    /// contents. Only mapped ranges are uploaded.
+    virtual bool Lock(void*& vertices, unsigned vertex_count, void*& indices, unsigned index_count) = 0;
+    /// Unmap geometry buffers and upload written data.
+    virtual void Unlock() = 0;
+    /// Return true if geometry uploaded previously was lost and has to be converted again. Resets the flag.
+    virtual bool CheckDataLost() = 0;
+    /// Get size of render target in pixels.
+    virtual Atomic::IntVector2 GetSize() const = 0;
+    /// Redirect following submissions into a render target texture and clear it. Null restores the backbuffer.
+    /// Geometry is written into render targets with premultiplied alpha.
+    virtual void SetRenderTarget(Atomic::Texture2D* target) = 0;
+    /// Return true if draw commands with non-zero vertex_start can be drawn.
+    virtual bool SupportsBaseVertex() const = 0;
+    /// Return true if geometry in packed vertex format, with TYPE_UBYTE4 position element, can be drawn.
+    virtual bool SupportsPackedVertices() const = 0;
+    /// Draw recorded commands using geometry uploaded last. Draw calls and state changes are added to stats.
+    virtual void Submit(const Atomic::PODVector<NuklearDrawCommand>& commands, unsigned vertex_count,
+                        const Atomic::Matrix4& projection, NuklearUIStats& stats) = 0;
+};
+
+/// Backend drawing with Atomic::Graphics.
+class NuklearGraphicsBackend
+    : public NuklearRenderBackend
+{
+public:
+    NuklearGraphicsBackend(Atomic::Graphics* graphics);
+
+    void ResizeBuffers(unsigned vertex_count, const Atomic::PODVector<Atomic::VertexElement>& elements,
+                       unsigned index_count) override;
+    unsigned GetVertexCapacity() const override { return _vertex_buffer->GetVertexCount(); }
+    unsigned GetIndexCapacity() const override { return _index_buffer->GetIndexCount(); }
+    bool Lock(void*& vertices, unsigned vertex_count, void*& indices, unsigned index_count) override;
+    void Unlock() override;
+    bool CheckDataLost() override;
+    Atomic::IntVector2 GetSize() const override;
+    void SetRenderTarget(Atomic::Texture2D* target) override;
+    bool SupportsBaseVertex() const override;
+    bool SupportsPackedVertices() const override;
+    void Submit(const Atomic::PODVector<NuklearDrawCommand>& commands, unsigned vertex_count,
+                const Atomic::Matrix4& projection, NuklearUIStats& stats) override;
+
+protected:
+    Atomic::WeakPtr<Atomic::Graphics> _graphics;
+    Atomic::SharedPtr<Atomic::VertexBuffer> _vertex_buffer;
+    Atomic::SharedPtr<Atomic::IndexBuffer> _index_buffer;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _vs_color;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_color;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _vs_diffmap;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_diffmap;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_alphamap;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _vs_packed_color;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _vs_packed_diffmap;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_premul_color;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_premul_diffmap;
+    Atomic::SharedPtr<Atomic::ShaderVariation> _ps_premul_alphamap;
+    /// Vertex buffer holds packed vertices.
+    bool _packed = false;
+    /// Submissions go into a render target texture.
+    bool _target_active = false;
+};
+
+/// Backend that keeps geometry in memory and records draw calls instead of drawing them. Used without GPU.
+class NuklearNullBackend
+    : public NuklearRenderBackend
+{
+public:
+    NuklearNullBackend(const Atomic::IntVector2& size = Atomic::IntVector2(1920, 1080));
+
+    void ResizeBuffers(unsigned vertex_count, const Atomic::PODVector<Atomic::VertexElement>& elements,
+                       unsigned index_count) override;
+    unsigned GetVertexCapacity() const override { return _vertex_capacity; }
+    unsigned GetIndexCapacity() const override { return _index_capacity; }
+    bool Lock(void*& vertices, unsigned vertex_count, void*& indices, unsigned index_count) override;
+    void Unlock() override { }
+    bool CheckDataLost() override { return false; }
+    Atomic::IntVector2 GetSize() const override { return _size; }
+    void SetRenderTarget(Atomic::Texture2D* target) override { }
+    bool SupportsBaseVertex() const override { return true; }
+    bool SupportsPackedVertices() const override { return true; }
+    void Submit(const Atomic::PODVector<NuklearDrawCommand>& commands, unsigned vertex_count,
+                const Atomic::Matrix4& projection, NuklearUIStats& stats) override;
+
+    /// Set size of emulated render target.
+    void SetSize(const Atomic::IntVector2& size) { _size = size; }
+    /// Get vertex data of last converted frame.
+    const Atomic::PODVector<unsigned char>& GetVertexData() const { return _vertex_data; }
+    /// Get index data of last converted frame.
+    const Atomic::PODVector<unsigned char>& GetIndexData() const { return _index_data; }
+    /// Get size of a vertex in bytes.
+    unsigned GetVertexSize() const { return _vertex_size; }
+    /// Get number of vertices used by last submitted frame.
+    unsigned GetSubmittedVertexCount() const { return _submitted_vertices; }
+    /// Get draw calls of last submitted frame.
+    const Atomic::PODVector<NuklearDrawCommand>& GetSubmittedCommands() const { return _submitted_commands; }
+    /// Get projection matrix of last submitted frame.
+    const Atomic::Matrix4& GetSubmittedProjection() const { return _submitted_projection; }
+    /// Get number of submitted frames.
+    unsigned GetSubmitCount() const { return _submit_count; }
+
+protected:
+    Atomic::IntVector2 _size;
+    unsigned _vertex_size = 0;
+    unsigned _vertex_capacity = 0;
+    unsigned _index_capacity = 0;
+    Atomic::PODVector<unsigned char> _vertex_data;
+    Atomic::PODVector<unsigned char> _index_data;
+    Atomic::PODVector<NuklearDrawCommand> _submitted_commands;
+    unsigned _submitted_vertices = 0;
+    Atomic::Matrix4 _submitted_projection;
+    unsigned _submit_count = 0;
+};
+
+}
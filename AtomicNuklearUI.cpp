@@ -31,14 +31,46 @@
 #include <Atomic/Input/InputEvents.h>
 #include <Atomic/Resource/ResourceCache.h>
 #include <Atomic/Core/Profiler.h>
+#include <Atomic/Core/Mutex.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Core/WorkQueue.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
 #include <Atomic/IO/Log.h>
+#include <Atomic/IO/MemoryBuffer.h>
 #include "AtomicNuklearUI.h"
 #undef NK_IMPLEMENTATION
 
+#if (defined(_WIN32) && !defined(ATOMIC_D3D11) && !defined(ATOMIC_OPENGL)) || defined(ATOMIC_D3D9)
+    // D3D9 samples pixel centers at integer coordinates, geometry must be shifted by half a pixel.
+#   define NKUI_HALF_PIXEL_OFFSET 1
+#endif
+
 using namespace std::placeholders;
 namespace Atomic
 {
 
+static const unsigned FONT_CACHE_MAGIC = 0x43414B4E;   // "NKAC"
+static const unsigned FONT_CACHE_VERSION = 2;
+
+/// FNV-1a hash of a memory block.
+static unsigned long long HashBytes(unsigned long long hash, const void* data, unsigned size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (unsigned i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template<typename T>
+static unsigned long long HashValue(unsigned long long hash, const T& value)
+{
+    return HashBytes(hash, &value, sizeof(value));
+}
+
 struct nk_sdl_vertex
 {
     float position[2];
@@ -46,6 +78,751 @@ struct nk_sdl_vertex
     nk_byte col[4];
 };
 
+static const unsigned INPUT_RECORD_MAGIC = 0x52494B4E;   // "NKIR"
+static const unsigned INPUT_RECORD_VERSION = 1;
+static const unsigned INPUT_RECORD_HEADER_SIZE = 8;
+
+/// Types of input recording records. Each type byte is followed by its arguments.
+enum NuklearInputRecord : unsigned char
+{
+    /// Frame start: float ui scale, int viewport width, int viewport height.
+    INPUT_RECORD_FRAME,
+    /// Frame end.
+    INPUT_RECORD_FRAME_END,
+    /// ubyte nk_keys, bool down.
+    INPUT_RECORD_KEY,
+    /// ubyte nk_buttons, short x, short y, bool down.
+    INPUT_RECORD_BUTTON,
+    /// short x, short y.
+    INPUT_RECORD_MOTION,
+    /// float x, float y.
+    INPUT_RECORD_SCROLL,
+    /// NK_UTF_SIZE bytes of a glyph.
+    INPUT_RECORD_GLYPH,
+};
+
+/// Vertex uploaded in packed format.
+struct nk_sdl_packed_vertex
+{
+    unsigned short position[2];
+    unsigned short uv[2];
+    nk_byte col[4];
+};
+
+// Packed positions store (x + PACKED_POSITION_ORIGIN) * PACKED_POSITION_SCALE. Must match NuklearPacked shaders.
+static const float PACKED_POSITION_ORIGIN = 1024.0f;
+static const float PACKED_POSITION_SCALE = 8.0f;
+/// Largest viewport extent in ui units that packed positions cover with PACKED_POSITION_ORIGIN margin on both sides.
+static const float PACKED_MAX_EXTENT = 65535.0f / PACKED_POSITION_SCALE - 2.0f * PACKED_POSITION_ORIGIN;
+/// Largest texture size that normalized 16-bit texture coordinates address with sub-texel precision.
+static const unsigned PACKED_MAX_TEXTURE_SIZE = 8192;
+
+/// Pack converted vertices. Positions outside of packed range are clamped, they lie far outside of viewport.
+static void PackVertices(void* dest, const void* source, unsigned count)
+{
+    auto src = static_cast<const nk_sdl_vertex*>(source);
+    auto dst = static_cast<nk_sdl_packed_vertex*>(dest);
+    for (unsigned i = 0; i < count; i++, src++, dst++)
+    {
+        for (unsigned c = 0; c < 2; c++)
+        {
+            float position = (src->position[c] + PACKED_POSITION_ORIGIN) * PACKED_POSITION_SCALE + 0.5f;
+            dst->position[c] = (unsigned short)Clamp(position, 0.0f, 65535.0f);
+            dst->uv[c] = (unsigned short)(Clamp(src->uv[c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+        memcpy(dst->col, src->col, sizeof(dst->col));
+    }
+}
+
+/// Return number of meaningful bytes of a nuklear command. Links between commands can not be used for this, because
+/// they jump over popups and between windows.
+static unsigned GetCommandSize(const struct nk_command* cmd)
+{
+    switch (cmd->type)
+    {
+    case NK_COMMAND_SCISSOR:            return sizeof(struct nk_command_scissor);
+    case NK_COMMAND_LINE:               return sizeof(struct nk_command_line);
+    case NK_COMMAND_CURVE:              return sizeof(struct nk_command_curve);
+    case NK_COMMAND_RECT:               return sizeof(struct nk_command_rect);
+    case NK_COMMAND_RECT_FILLED:        return sizeof(struct nk_command_rect_filled);
+    case NK_COMMAND_RECT_MULTI_COLOR:   return sizeof(struct nk_command_rect_multi_color);
+    case NK_COMMAND_CIRCLE:             return sizeof(struct nk_command_circle);
+    case NK_COMMAND_CIRCLE_FILLED:      return sizeof(struct nk_command_circle_filled);
+    case NK_COMMAND_ARC:                return sizeof(struct nk_command_arc);
+    case NK_COMMAND_ARC_FILLED:         return sizeof(struct nk_command_arc_filled);
+    case NK_COMMAND_TRIANGLE:           return sizeof(struct nk_command_triangle);
+    case NK_COMMAND_TRIANGLE_FILLED:    return sizeof(struct nk_command_triangle_filled);
+    case NK_COMMAND_IMAGE:              return sizeof(struct nk_command_image);
+    case NK_COMMAND_CUSTOM:             return sizeof(struct nk_command_custom);
+    case NK_COMMAND_POLYGON:
+    case NK_COMMAND_POLYLINE:
+    {
+        // Outlined polygons and polylines share layout of nk_command_polygon. Trailing padding is not included.
+        auto p = (const struct nk_command_polygon*)cmd;
+        return (unsigned)(NK_OFFSETOF(struct nk_command_polygon, points) + p->point_count * sizeof(struct nk_vec2i));
+    }
+    case NK_COMMAND_POLYGON_FILLED:
+    {
+        auto p = (const struct nk_command_polygon_filled*)cmd;
+        return (unsigned)(NK_OFFSETOF(struct nk_command_polygon_filled, points) +
+                          p->point_count * sizeof(struct nk_vec2i));
+    }
+    case NK_COMMAND_TEXT:
+    {
+        auto t = (const struct nk_command_text*)cmd;
+        return (unsigned)(NK_OFFSETOF(struct nk_command_text, string) + t->length);
+    }
+    default:                            return sizeof(struct nk_command);
+    }
+}
+
+/// Hash contents of a nuklear command. Link to next command is excluded, so hash does not depend on command location.
+static unsigned long long HashCommand(unsigned long long hash, const struct nk_command* cmd)
+{
+    hash = HashValue(hash, cmd->type);
+#ifdef NK_INCLUDE_COMMAND_USERDATA
+    hash = HashValue(hash, cmd->userdata);
+#endif
+    return HashBytes(hash, cmd + 1, GetCommandSize(cmd) - (unsigned)sizeof(struct nk_command));
+}
+
+/// Return number of segments approximating a circle of given radius in pixels within half a pixel of error.
+static unsigned GetCircleSegmentCount(float radius, unsigned max_segments)
+{
+    static const float MAX_ERROR = 0.5f;
+    unsigned segments = 4;
+    if (radius > MAX_ERROR)
+        segments = (unsigned)Ceil(2 * M_PI / acosf(1.0f - MAX_ERROR / radius));
+    return Clamp(segments, Min(4u, max_segments), max_segments);
+}
+
+/// Return number of segments of a curve whose control polygon is given length in pixels.
+static unsigned GetCurveSegmentCount(float length, unsigned max_segments)
+{
+    static const float PIXELS_PER_SEGMENT = 4.0f;
+    return Clamp((unsigned)Ceil(length / PIXELS_PER_SEGMENT), Min(2u, max_segments), max_segments);
+}
+
+/// Return number of segments of an arc. Arc gets share of segments of a full circle proportional to its angle.
+static unsigned GetArcSegmentCount(float radius, float angle, unsigned max_segments, float pixel_scale)
+{
+    if (!pixel_scale)
+        return max_segments;
+    unsigned segments = GetCircleSegmentCount(radius * pixel_scale, max_segments);
+    return Clamp((unsigned)Ceil(segments * Abs(angle) / (2 * M_PI)), Min(2u, max_segments), max_segments);
+}
+
+static float Distance(const struct nk_vec2i& a, const struct nk_vec2i& b)
+{
+    return sqrtf((float)((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y)));
+}
+
+//! Tessellate a single nuklear command into draw list. Mirrors command handling of nk_convert().
+/*!
+  \param pixel_scale pixels per ui unit. When not 0 circle, arc and curve segment counts are computed from size of
+         primitive on screen, counts of config are upper limits.
+*/
+static void ConvertCommand(struct nk_draw_list* list, const struct nk_command* cmd, const struct nk_convert_config& config,
+                           float pixel_scale)
+{
+#ifdef NK_INCLUDE_COMMAND_USERDATA
+    list->userdata = cmd->userdata;
+#endif
+    switch (cmd->type)
+    {
+    case NK_COMMAND_NOP:
+        break;
+    case NK_COMMAND_SCISSOR:
+    {
+        auto s = (const struct nk_command_scissor*)cmd;
+        nk_draw_list_add_clip(list, nk_rect(s->x, s->y, s->w, s->h));
+        break;
+    }
+    case NK_COMMAND_LINE:
+    {
+        auto l = (const struct nk_command_line*)cmd;
+        nk_draw_list_stroke_line(list, nk_vec2(l->begin.x, l->begin.y), nk_vec2(l->end.x, l->end.y), l->color,
+                                 l->line_thickness);
+        break;
+    }
+    case NK_COMMAND_CURVE:
+    {
+        auto q = (const struct nk_command_curve*)cmd;
+        unsigned segments = config.curve_segment_count;
+        if (pixel_scale)
+        {
+            float length = Distance(q->begin, q->ctrl[0]) + Distance(q->ctrl[0], q->ctrl[1]) + Distance(q->ctrl[1], q->end);
+            segments = GetCurveSegmentCount(length * pixel_scale, segments);
+        }
+        nk_draw_list_stroke_curve(list, nk_vec2(q->begin.x, q->begin.y), nk_vec2(q->ctrl[0].x, q->ctrl[0].y),
+                                  nk_vec2(q->ctrl[1].x, q->ctrl[1].y), nk_vec2(q->end.x, q->end.y), q->color,
+                                  segments, q->line_thickness);
+        break;
+    }
+    case NK_COMMAND_RECT:
+    {
+        auto r = (const struct nk_command_rect*)cmd;
+        nk_draw_list_stroke_rect(list, nk_rect(r->x, r->y, r->w, r->h), r->color, (float)r->rounding,
+                                 r->line_thickness);
+        break;
+    }
+    case NK_COMMAND_RECT_FILLED:
+    {
+        auto r = (const struct nk_command_rect_filled*)cmd;
+        nk_draw_list_fill_rect(list, nk_rect(r->x, r->y, r->w, r->h), r->color, (float)r->rounding);
+        break;
+    }
+    case NK_COMMAND_RECT_MULTI_COLOR:
+    {
+        auto r = (const struct nk_command_rect_multi_color*)cmd;
+        nk_draw_list_fill_rect_multi_color(list, nk_rect(r->x, r->y, r->w, r->h), r->left, r->top, r->right,
+                                           r->bottom);
+        break;
+    }
+    case NK_COMMAND_CIRCLE:
+    {
+        auto c = (const struct nk_command_circle*)cmd;
+        unsigned segments = config.circle_segment_count;
+        if (pixel_scale)
+            segments = GetCircleSegmentCount(c->w * 0.5f * pixel_scale, segments);
+        nk_draw_list_stroke_circle(list, nk_vec2((float)c->x + (float)c->w / 2, (float)c->y + (float)c->h / 2),
+                                   (float)c->w / 2, c->color, segments, c->line_thickness);
+        break;
+    }
+    case NK_COMMAND_CIRCLE_FILLED:
+    {
+        auto c = (const struct nk_command_circle_filled*)cmd;
+        unsigned segments = config.circle_segment_count;
+        if (pixel_scale)
+            segments = GetCircleSegmentCount(c->w * 0.5f * pixel_scale, segments);
+        nk_draw_list_fill_circle(list, nk_vec2((float)c->x + (float)c->w / 2, (float)c->y + (float)c->h / 2),
+                                 (float)c->w / 2, c->color, segments);
+        break;
+    }
+    case NK_COMMAND_ARC:
+    {
+        auto c = (const struct nk_command_arc*)cmd;
+        nk_draw_list_path_line_to(list, nk_vec2(c->cx, c->cy));
+        nk_draw_list_path_arc_to(list, nk_vec2(c->cx, c->cy), c->r, c->a[0], c->a[1],
+                                 GetArcSegmentCount(c->r, c->a[1] - c->a[0], config.arc_segment_count, pixel_scale));
+        nk_draw_list_path_stroke(list, c->color, NK_STROKE_CLOSED, c->line_thickness);
+        break;
+    }
+    case NK_COMMAND_ARC_FILLED:
+    {
+        auto c = (const struct nk_command_arc_filled*)cmd;
+        nk_draw_list_path_line_to(list, nk_vec2(c->cx, c->cy));
+        nk_draw_list_path_arc_to(list, nk_vec2(c->cx, c->cy), c->r, c->a[0], c->a[1],
+                                 GetArcSegmentCount(c->r, c->a[1] - c->a[0], config.arc_segment_count, pixel_scale));
+        nk_draw_list_path_fill(list, c->color);
+        break;
+    }
+    case NK_COMMAND_TRIANGLE:
+    {
+        auto t = (const struct nk_command_triangle*)cmd;
+        nk_draw_list_stroke_triangle(list, nk_vec2(t->a.x, t->a.y), nk_vec2(t->b.x, t->b.y),
+                                     nk_vec2(t->c.x, t->c.y), t->color, t->line_thickness);
+        break;
+    }
+    case NK_COMMAND_TRIANGLE_FILLED:
+    {
+        auto t = (const struct nk_command_triangle_filled*)cmd;
+        nk_draw_list_fill_triangle(list, nk_vec2(t->a.x, t->a.y), nk_vec2(t->b.x, t->b.y), nk_vec2(t->c.x, t->c.y),
+                                   t->color);
+        break;
+    }
+    case NK_COMMAND_POLYGON:
+    case NK_COMMAND_POLYLINE:
+    {
+        auto p = (const struct nk_command_polygon*)cmd;
+        for (int i = 0; i < p->point_count; i++)
+            nk_draw_list_path_line_to(list, nk_vec2((float)p->points[i].x, (float)p->points[i].y));
+        nk_draw_list_path_stroke(list, p->color, cmd->type == NK_COMMAND_POLYGON ? NK_STROKE_CLOSED : NK_STROKE_OPEN,
+                                 p->line_thickness);
+        break;
+    }
+    case NK_COMMAND_POLYGON_FILLED:
+    {
+        auto p = (const struct nk_command_polygon_filled*)cmd;
+        for (int i = 0; i < p->point_count; i++)
+            nk_draw_list_path_line_to(list, nk_vec2((float)p->points[i].x, (float)p->points[i].y));
+        nk_draw_list_path_fill(list, p->color);
+        break;
+    }
+    case NK_COMMAND_TEXT:
+    {
+        auto t = (const struct nk_command_text*)cmd;
+        nk_draw_list_add_text(list, t->font, nk_rect(t->x, t->y, t->w, t->h), t->string, t->length, t->height,
+                              t->foreground);
+        break;
+    }
+    case NK_COMMAND_IMAGE:
+    {
+        auto i = (const struct nk_command_image*)cmd;
+        nk_draw_list_add_image(list, i->img, nk_rect(i->x, i->y, i->w, i->h), i->col);
+        break;
+    }
+    case NK_COMMAND_CUSTOM:
+    {
+        auto c = (const struct nk_command_custom*)cmd;
+        c->callback(list, c->x, c->y, c->w, c->h, c->callback_data);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/// Start a new draw command with current clip rectangle, so that following geometry is not merged into previous
+/// command. Returns index of the new command.
+static unsigned SplitDrawList(struct nk_draw_list* list)
+{
+    struct nk_rect clip = list->cmd_count ? nk_draw_list_command_last(list)->clip_rect : nk_null_rect;
+    nk_draw_list_add_clip(list, clip);
+    return list->cmd_count - 1;
+}
+
+/// Return upper bound of vertices converting a command adds to a draw list. Every path point produces at most four
+/// vertices. Custom commands can not be inspected and are assumed to be moderately sized.
+static unsigned EstimateVertexCount(const struct nk_command* cmd, const struct nk_convert_config& config)
+{
+    static const unsigned CUSTOM_COMMAND_VERTICES = 4096;
+    switch (cmd->type)
+    {
+    case NK_COMMAND_TEXT:
+        return ((const struct nk_command_text*)cmd)->length * 4u;
+    case NK_COMMAND_POLYGON:
+        return ((const struct nk_command_polygon*)cmd)->point_count * 4u;
+    case NK_COMMAND_POLYGON_FILLED:
+        return ((const struct nk_command_polygon_filled*)cmd)->point_count * 4u;
+    case NK_COMMAND_POLYLINE:
+        return ((const struct nk_command_polyline*)cmd)->point_count * 4u;
+    case NK_COMMAND_CIRCLE:
+    case NK_COMMAND_CIRCLE_FILLED:
+        return (config.circle_segment_count + 1) * 4;
+    case NK_COMMAND_ARC:
+    case NK_COMMAND_ARC_FILLED:
+        return (config.arc_segment_count + 2) * 4;
+    case NK_COMMAND_CURVE:
+        return (config.curve_segment_count + 1) * 4;
+    case NK_COMMAND_CUSTOM:
+        return CUSTOM_COMMAND_VERTICES;
+    default:
+        // Rounded rectangles have the most points, four corners of at most four points each.
+        return 64;
+    }
+}
+
+/// Forget vertex chunks of previous conversion.
+static void ClearVertexChunks(NuklearVertexChunks& chunks)
+{
+    chunks.base = 0;
+    chunks.commands.Clear();
+    chunks.vertices.Clear();
+}
+
+/// Start a new vertex chunk if adding `count` vertices to current one could overflow 16-bit indices. Indices nuklear
+/// writes are relative to draw list vertex count, which is reset to make them relative to the new chunk.
+static void ReserveVertices(struct nk_draw_list* list, NuklearVertexChunks& chunks, unsigned count)
+{
+    if (!chunks.enabled || !list->vertex_count || list->vertex_count + count < NK_USHORT_MAX)
+        return;
+    chunks.base += list->vertex_count;
+    list->vertex_count = 0;
+    chunks.commands.Push(SplitDrawList(list));
+    chunks.vertices.Push(chunks.base);
+}
+
+/// Font rasterizing glyphs on first use into a fixed size alpha texture. Least recently used glyphs are evicted when
+/// texture is full. nk_user_font references a single texture, therefore each font owns one texture page.
+class NuklearDynamicFont : public RefCounted
+{
+public:
+    NuklearDynamicFont(Context* context, PODVector<unsigned char>& ttf, float size, int texture_size)
+        : _size(size)
+        , _texture_size(texture_size)
+    {
+        _ttf.Swap(ttf);
+        if (!nk_tt_InitFont(&_info, &_ttf.Front(), 0))
+            return;
+
+        int ascent, descent, line_gap;
+        nk_tt_GetFontVMetrics(&_info, &ascent, &descent, &line_gap);
+        _scale = nk_tt_ScaleForPixelHeight(&_info, size);
+        _ascent = ascent * _scale;
+        // One pixel of padding on each side keeps bilinear filtering from sampling neighbour glyphs.
+        _cell_size = (int)Ceil((ascent - descent) * _scale) + 2;
+        _columns = texture_size / _cell_size;
+        if (_columns <= 0)
+            return;
+        _slots.Resize((unsigned)(_columns * _columns));
+        for (GlyphSlot& slot : _slots)
+            slot.codepoint = 0;
+
+        _pixels.Resize((unsigned)(texture_size * texture_size));
+        memset(&_pixels.Front(), 0, _pixels.Size());
+        _texture = context->CreateObject<Texture2D>();
+        _texture->SetNumLevels(1);
+        _texture->SetSize(texture_size, texture_size, Graphics::GetAlphaFormat());
+        _upload_enabled = context->GetSubsystem<Graphics>() != 0;
+        if (_upload_enabled)
+            _texture->SetData(0, 0, 0, texture_size, texture_size, &_pixels.Front());
+        _dirty = IntRect(texture_size, texture_size, 0, 0);
+
+        _handle.userdata = nk_handle_ptr(this);
+        _handle.height = size;
+        _handle.width = &TextWidth;
+        _handle.query = &QueryGlyph;
+        _handle.texture = nk_handle_ptr(_texture.Get());
+        _valid = true;
+    }
+
+    /// Return true if font was loaded.
+    bool IsValid() const { return _valid; }
+    /// Return nuklear font handle.
+    nk_user_font* GetUserFont() { return &_handle; }
+    /// Start new frame. Glyphs used in current frame are never evicted.
+    void BeginFrame() { _frame++; }
+    /// Return number of glyphs evicted from texture so far.
+    unsigned GetEvictions() const { return _evictions; }
+    /// Upload region of texture that was modified by rasterizing new glyphs.
+    void UploadDirtyRegion()
+    {
+        if (_dirty.left_ >= _dirty.right_ || _dirty.top_ >= _dirty.bottom_)
+            return;
+        if (!_upload_enabled)
+        {
+            _dirty = IntRect(_texture_size, _texture_size, 0, 0);
+            return;
+        }
+
+        int width = _dirty.Width();
+        int height = _dirty.Height();
+        _upload.Resize((unsigned)(width * height));
+        for (int y = 0; y < height; y++)
+            memcpy(&_upload[y * width], &_pixels[(_dirty.top_ + y) * _texture_size + _dirty.left_], (size_t)width);
+        _texture->SetData(0, _dirty.left_, _dirty.top_, width, height, &_upload.Front());
+        _dirty = IntRect(_texture_size, _texture_size, 0, 0);
+    }
+
+private:
+    struct GlyphSlot
+    {
+        nk_rune codepoint;
+        unsigned last_used;
+        struct nk_user_font_glyph glyph;
+    };
+
+    static float TextWidth(nk_handle handle, float height, const char* text, int len)
+    {
+        auto font = static_cast<NuklearDynamicFont*>(handle.ptr);
+        MutexLock lock(font->_mutex);
+        float width = 0;
+        int pos = 0;
+        while (pos < len)
+        {
+            nk_rune codepoint;
+            int glyph_len = nk_utf_decode(text + pos, &codepoint, len - pos);
+            if (!glyph_len)
+                break;
+            width += font->GetAdvance(codepoint);
+            pos += glyph_len;
+        }
+        return width * height / font->_size;
+    }
+
+    static void QueryGlyph(nk_handle handle, float height, struct nk_user_font_glyph* glyph, nk_rune codepoint,
+                           nk_rune next_codepoint)
+    {
+        auto font = static_cast<NuklearDynamicFont*>(handle.ptr);
+        // Windows may be tessellated in parallel.
+        MutexLock lock(font->_mutex);
+        float scale = height / font->_size;
+        int slot = font->GetSlot(codepoint);
+        if (slot < 0)
+        {
+            // Texture is full of glyphs used in this frame, glyph is left out but layout stays intact.
+            NK_MEMSET(glyph, 0, sizeof(*glyph));
+            glyph->xadvance = font->GetAdvance(codepoint) * scale;
+            return;
+        }
+
+        *glyph = font->_slots[slot].glyph;
+        glyph->offset.x *= scale;
+        glyph->offset.y *= scale;
+        glyph->width *= scale;
+        glyph->height *= scale;
+        glyph->xadvance *= scale;
+        (void)next_codepoint;
+    }
+
+    float GetAdvance(nk_rune codepoint)
+    {
+        auto it = _advances.Find(codepoint);
+        if (it != _advances.End())
+            return it->second_;
+
+        int advance, left_bearing;
+        nk_tt_GetGlyphHMetrics(&_info, nk_tt_FindGlyphIndex(&_info, (int)codepoint), &advance, &left_bearing);
+        return _advances[codepoint] = advance * _scale;
+    }
+
+    int GetSlot(nk_rune codepoint)
+    {
+        auto it = _slot_index.Find(codepoint);
+        if (it != _slot_index.End())
+        {
+            _slots[it->second_].last_used = _frame;
+            return it->second_;
+        }
+
+        // Pick empty slot or least recently used one that is not referenced by current frame.
+        int victim = -1;
+        for (unsigned i = 0; i < _slots.Size(); i++)
+        {
+            const GlyphSlot& slot = _slots[i];
+            if (!slot.codepoint)
+            {
+                victim = i;
+                break;
+            }
+            if (slot.last_used != _frame && (victim < 0 || slot.last_used < _slots[victim].last_used))
+                victim = i;
+        }
+        if (victim < 0)
+            return -1;
+
+        GlyphSlot& slot = _slots[victim];
+        if (slot.codepoint)
+        {
+            _slot_index.Erase(slot.codepoint);
+            _evictions++;
+        }
+        Rasterize(victim, codepoint);
+        slot.codepoint = codepoint;
+        slot.last_used = _frame;
+        _slot_index[codepoint] = (unsigned)victim;
+        return victim;
+    }
+
+    void Rasterize(int index, nk_rune codepoint)
+    {
+        int glyph_index = nk_tt_FindGlyphIndex(&_info, (int)codepoint);
+        int x0, y0, x1, y1;
+        nk_tt_GetGlyphBitmapBoxSubpixel(&_info, glyph_index, _scale, _scale, 0, 0, &x0, &y0, &x1, &y1);
+        int width = Min(x1 - x0, _cell_size - 2);
+        int height = Min(y1 - y0, _cell_size - 2);
+
+        int cell_x = (index % _columns) * _cell_size;
+        int cell_y = (index / _columns) * _cell_size;
+        for (int y = 0; y < _cell_size; y++)
+            memset(&_pixels[(cell_y + y) * _texture_size + cell_x], 0, (size_t)_cell_size);
+        if (width > 0 && height > 0)
+        {
+            nk_tt_MakeGlyphBitmapSubpixel(&_info, &_pixels[(cell_y + 1) * _texture_size + cell_x + 1], width, height,
+                                          _texture_size, _scale, _scale, 0, 0, glyph_index);
+        }
+        _dirty.left_ = Min(_dirty.left_, cell_x);
+        _dirty.top_ = Min(_dirty.top_, cell_y);
+        _dirty.right_ = Max(_dirty.right_, cell_x + _cell_size);
+        _dirty.bottom_ = Max(_dirty.bottom_, cell_y + _cell_size);
+
+        struct nk_user_font_glyph& glyph = _slots[index].glyph;
+        float inv_size = 1.0f / _texture_size;
+        glyph.uv[0] = nk_vec2((cell_x + 1) * inv_size, (cell_y + 1) * inv_size);
+        glyph.uv[1] = nk_vec2((cell_x + 1 + width) * inv_size, (cell_y + 1 + height) * inv_size);
+        glyph.offset = nk_vec2((float)x0, _ascent + y0);
+        glyph.width = (float)width;
+        glyph.height = (float)height;
+        glyph.xadvance = GetAdvance(codepoint);
+    }
+
+    PODVector<unsigned char> _ttf;
+    struct nk_tt_fontinfo _info;
+    struct nk_user_font _handle;
+    float _size;
+    float _scale = 1.0f;
+    float _ascent = 0;
+    int _texture_size;
+    int _cell_size = 0;
+    int _columns = 0;
+    unsigned _frame = 0;
+    unsigned _evictions = 0;
+    bool _valid = false;
+    bool _upload_enabled = false;
+    PODVector<GlyphSlot> _slots;
+    HashMap<nk_rune, unsigned> _slot_index;
+    HashMap<nk_rune, float> _advances;
+    PODVector<unsigned char> _pixels;
+    PODVector<unsigned char> _upload;
+    IntRect _dirty;
+    SharedPtr<Texture2D> _texture;
+    Mutex _mutex;
+};
+
+/// Tessellates a single command segment into its own draw list, so that segments can be tessellated in parallel.
+class NuklearSegmentTessellator : public RefCounted
+{
+public:
+    NuklearSegmentTessellator()
+    {
+        nk_draw_list_init(&_list);
+        nk_buffer_init_default(&_commands);
+        nk_buffer_init_default(&_vertices);
+        nk_buffer_init_default(&_elements);
+    }
+
+    ~NuklearSegmentTessellator()
+    {
+        nk_buffer_free(&_commands);
+        nk_buffer_free(&_vertices);
+        nk_buffer_free(&_elements);
+    }
+
+    /// Set segment to be tessellated.
+    void Setup(struct nk_context* ctx, const NuklearCommandSegment& segment, const struct nk_convert_config* config,
+               float pixel_scale, bool chunked)
+    {
+        _chunks.enabled = chunked;
+        _ctx = ctx;
+        _pixel_scale = pixel_scale;
+        _segment = segment;
+        _config = config;
+        _hash = segment.hash;
+        _complete = false;
+    }
+
+    /// Return hash of tessellated segment.
+    unsigned long long GetHash() const { return _hash; }
+    /// Set frame number in which tessellated geometry was used last.
+    void SetLastUsed(unsigned frame) { _last_used = frame; }
+    /// Return frame number in which tessellated geometry was used last.
+    unsigned GetLastUsed() const { return _last_used; }
+
+    //! Tessellate segment.
+    /*!
+      \param allow_custom run callbacks of custom commands. They are user code which may run only on main thread.
+      \return false if tessellation stopped on a custom command.
+    */
+    bool Tessellate(bool allow_custom)
+    {
+        nk_buffer_clear(&_commands);
+        nk_buffer_clear(&_vertices);
+        nk_buffer_clear(&_elements);
+        ClearVertexChunks(_chunks);
+        nk_draw_list_setup(&_list, _config, &_commands, &_vertices, &_elements, _config->line_AA, _config->shape_AA);
+        // Commands preceding first scissor use clip rectangle of previous segment, which is known only when joining.
+        nk_draw_list_add_clip(&_list, INHERIT_CLIP);
+        for (const struct nk_command* cmd = _segment.first;; cmd = nk__next(_ctx, cmd))
+        {
+            if (cmd->type == NK_COMMAND_CUSTOM && !allow_custom)
+                return false;
+            ReserveVertices(&_list, _chunks, EstimateVertexCount(cmd, *_config));
+            ConvertCommand(&_list, cmd, *_config, _pixel_scale);
+            if (cmd == _segment.last)
+                break;
+        }
+        _complete = true;
+        return true;
+    }
+
+    /// Return true if segment was tessellated.
+    bool IsComplete() const { return _complete; }
+
+    /// Append tessellated geometry to a draw list, rebasing indices. Produces same geometry as tessellating segment
+    /// directly into that draw list.
+    void AppendTo(struct nk_draw_list* list, NuklearVertexChunks& chunks) const
+    {
+        unsigned base = 0;
+        unsigned chunk = 0;
+        unsigned cmd_index = 0;
+        auto indices = static_cast<const nk_draw_index*>(nk_buffer_memory_const(&_elements));
+        const struct nk_draw_command* cmd;
+        nk_draw_list_foreach(cmd, &_list, &_commands)
+        {
+            // Local chunks are appended whole, so that their indices stay within one chunk of the draw list.
+            if (chunk <= _chunks.commands.Size() && cmd_index == (chunk ? _chunks.commands[chunk - 1] : 0))
+            {
+                if (!AppendChunk(list, chunks, chunk++, base))
+                    return;
+            }
+            cmd_index++;
+
+            struct nk_draw_command* last = list->cmd_count ? nk_draw_list_command_last(list) : 0;
+            struct nk_rect clip = cmd->clip_rect;
+            if (clip.w < 0)
+                clip = last ? last->clip_rect : nk_null_rect;
+            bool same_clip = last && memcmp(&last->clip_rect, &clip, sizeof(clip)) == 0;
+            if (!cmd->elem_count)
+            {
+                // Keep clip state, following segments may depend on it.
+                if (!same_clip)
+                    nk_draw_list_add_clip(list, clip);
+                continue;
+            }
+
+#ifdef NK_INCLUDE_COMMAND_USERDATA
+            bool same_userdata = last && last->userdata.ptr == cmd->userdata.ptr;
+            list->userdata = cmd->userdata;
+#else
+            bool same_userdata = true;
+#endif
+            if (!same_clip || !same_userdata || last->texture.ptr != cmd->texture.ptr)
+                nk_draw_list_push_command(list, clip, cmd->texture);
+
+            nk_draw_index* dst = nk_draw_list_alloc_elements(list, cmd->elem_count);
+            if (!dst)
+                return;
+            for (unsigned i = 0; i < cmd->elem_count; i++)
+                dst[i] = (nk_draw_index)(indices[i] + base);
+            indices += cmd->elem_count;
+        }
+    }
+
+private:
+    /// Copy vertices of a local chunk to a draw list. Outputs index of first copied vertex within chunk of draw list.
+    bool AppendChunk(struct nk_draw_list* list, NuklearVertexChunks& chunks, unsigned chunk, unsigned& base) const
+    {
+        unsigned first = chunk ? _chunks.vertices[chunk - 1] : 0;
+        unsigned end = chunk < _chunks.vertices.Size() ? _chunks.vertices[chunk] : _chunks.base + _list.vertex_count;
+        ReserveVertices(list, chunks, end - first);
+        base = list->vertex_count;
+        if (end == first)
+            return true;
+        void* vertices = nk_draw_list_alloc_vertices(list, end - first);
+        if (!vertices)
+            return false;
+        unsigned vertex_size = (unsigned)list->config.vertex_size;
+        memcpy(vertices, (const unsigned char*)nk_buffer_memory_const(&_vertices) + first * vertex_size,
+               (end - first) * vertex_size);
+        return true;
+    }
+
+    /// Clip rectangle marking commands that inherit clip of previous segment. Scissors never have negative size.
+    static const struct nk_rect INHERIT_CLIP;
+
+    struct nk_draw_list _list;
+    struct nk_buffer _commands;
+    struct nk_buffer _vertices;
+    struct nk_buffer _elements;
+    NuklearVertexChunks _chunks;
+    struct nk_context* _ctx = 0;
+    NuklearCommandSegment _segment;
+    const struct nk_convert_config* _config = 0;
+    float _pixel_scale = 0;
+    unsigned long long _hash = 0;
+    unsigned _last_used = 0;
+    bool _complete = false;
+};
+
+const struct nk_rect NuklearSegmentTessellator::INHERIT_CLIP = {0, 0, -1, -1};
+
+static void TessellateWork(const WorkItem* item, unsigned threadIndex)
+{
+    static_cast<NuklearSegmentTessellator*>(item->aux_)->Tessellate(false);
+    (void)threadIndex;
+}
+
 void NuklearUI::ClipboardCopy(nk_handle usr, const char* text, int len)
 {
     String str(text, (unsigned int)len);
@@ -60,28 +837,113 @@ void NuklearUI::ClipboardPaste(nk_handle usr, struct nk_text_edit* edit)
     (void)usr;
 }
 
+void* NuklearUI::ArenaAlloc(nk_handle arena, void* old, nk_size size)
+{
+    auto a = static_cast<NuklearArena*>(arena.ptr);
+    unsigned offset = (a->used + 15) & ~15u;
+    if (offset + size > a->size)
+    {
+        a->overflows++;
+        return malloc(size);
+    }
+    a->last = offset;
+    a->used = (unsigned)(offset + size);
+    (void)old;
+    return a->memory + offset;
+}
+
+void NuklearUI::ArenaFree(nk_handle arena, void* memory)
+{
+    // Arena memory is released all at once, only allocations which spilled over to heap are freed. Most recent
+    // allocation is popped, so glyphs that every bake allocates last reuse memory of the previous bake.
+    auto a = static_cast<NuklearArena*>(arena.ptr);
+    auto bytes = static_cast<unsigned char*>(memory);
+    if (bytes && (bytes < a->memory || bytes >= a->memory + a->size))
+        free(memory);
+    else if (bytes && a->last != M_MAX_UNSIGNED && bytes == a->memory + a->last)
+    {
+        a->used = a->last;
+        a->last = M_MAX_UNSIGNED;
+    }
+}
+
 NuklearUI::NuklearUI(Context* context)
+    : NuklearUI(context, NuklearMemoryConfig())
+{
+}
+
+NuklearUI::NuklearUI(Context* context, const NuklearMemoryConfig& memory)
     : Object(context)
 {
     _graphics = GetSubsystem<Graphics>();
 
-    _index_buffer = new IndexBuffer(context_);
-    _vertex_buffer = new VertexBuffer(context_);
+    if (_graphics)
+        _backend = new NuklearGraphicsBackend(_graphics);
+    else
+    {
+        SharedPtr<NuklearNullBackend> headless(new NuklearNullBackend());
+        _headless_backend = headless;
+        _backend = headless.Get();
+    }
+    _vertex_chunks.enabled = sizeof(nk_draw_index) == 2 && _backend->SupportsBaseVertex();
+    _vertex_elements.Push(VertexElement(TYPE_VECTOR2, SEM_POSITION));
+    _vertex_elements.Push(VertexElement(TYPE_VECTOR2, SEM_TEXCOORD));
+    _vertex_elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
     _null_texture = context_->CreateObject<Texture2D>();
 
-    nk_init_default(&_nk, 0);
-    nk_font_atlas_init_default(&_atlas);
+    if (memory.frame_budget)
+    {
+        void* frame_memory = memory.frame_memory;
+        if (!frame_memory)
+        {
+            _frame_memory.Resize(memory.frame_budget);
+            frame_memory = &_frame_memory.Front();
+        }
+        nk_init_fixed(&_nk, frame_memory, memory.frame_budget, 0);
+    }
+    else
+        nk_init_default(&_nk, 0);
+
+    if (memory.atlas_budget)
+    {
+        _atlas_arena.memory = static_cast<unsigned char*>(memory.atlas_memory);
+        if (!_atlas_arena.memory)
+        {
+            _atlas_memory.Resize(memory.atlas_budget);
+            _atlas_arena.memory = &_atlas_memory.Front();
+        }
+        _atlas_arena.size = memory.atlas_budget;
+
+        // Baking scratch memory is released right after baking, it stays on the heap.
+        struct nk_allocator persistent = {nk_handle_ptr(&_atlas_arena), &ArenaAlloc, &ArenaFree};
+        struct nk_allocator transient = {nk_handle_ptr(0), &nk_malloc, &nk_mfree};
+        nk_font_atlas_init_custom(&_atlas, &persistent, &transient);
+    }
+    else
+        nk_font_atlas_init_default(&_atlas);
     _nk.clip.copy = &ClipboardCopy;
     _nk.clip.paste = &ClipboardPaste;
     _nk.clip.userdata = nk_handle_ptr(0);
 
-    nk_buffer_init_default(&_commands);
-    ReallocateBuffers(1024, 1024);
+    if (memory.command_budget)
+    {
+        void* command_memory = memory.command_memory;
+        if (!command_memory)
+        {
+            _command_memory.Resize(memory.command_budget);
+            command_memory = &_command_memory.Front();
+        }
+        nk_buffer_init_fixed(&_commands, command_memory, memory.command_budget);
+    }
+    else
+        nk_buffer_init_default(&_commands);
+    ReallocateBuffers(_buffer_high_water_vertices, _buffer_high_water_indices);
 
     unsigned whiteOpaque = 0xffffffff;
     _null_texture->SetNumLevels(1);
     _null_texture->SetSize(1, 1, Graphics::GetRGBAFormat());
-    _null_texture->SetData(0, 0, 0, 1, 1, &whiteOpaque);
+    if (_graphics)
+        _null_texture->SetData(0, 0, 0, 1, 1, &whiteOpaque);
     _draw_null_texture.texture.ptr = _null_texture.Get();
 
     static const struct nk_draw_vertex_layout_element vertex_layout[] = {
@@ -106,30 +968,61 @@ NuklearUI::NuklearUI(Context* context)
 
     SubscribeToEvent(E_POSTUPDATE, [=](StringHash, VariantMap&) {
         ATOMIC_PROFILE(NuklearFrame);
+        HiresTimer timer;
+        ReplayInputFrame();
         SendEvent(E_NUKLEARFRAME);
+        _stats.frame_time_us = (unsigned)timer.GetUSec(false);
+        if (_pipelined)
+            BeginStagedConvert();
     });
     SubscribeToEvent(E_INPUTBEGIN, std::bind(&NuklearUI::OnInputBegin, this));
     SubscribeToEvent(E_SDLRAWINPUT, std::bind(&NuklearUI::OnRawEvent, this, _2));
     SubscribeToEvent(E_INPUTEND, std::bind(&NuklearUI::OnInputEnd, this));
-    SubscribeToEvent(E_ENDRENDERING, std::bind(&NuklearUI::OnEndRendering, this));
+    if (_graphics)
+        SubscribeToEvent(E_ENDRENDERING, std::bind(&NuklearUI::OnEndRendering, this));
+    else
+        SubscribeToEvent(E_ENDFRAME, std::bind(&NuklearUI::Render, this));
     SubscribeToEvent(E_SCREENMODE, std::bind(&NuklearUI::UpdateProjectionMatrix, this));
 }
 
 NuklearUI::~NuklearUI()
 {
     UnsubscribeFromAllEvents();
+    StopInputRecording();
+    if (_convert_item)
+        GetSubsystem<WorkQueue>()->Complete(M_MAX_UNSIGNED);
     nk_font_atlas_clear(&_atlas);
+    nk_buffer_free(&_commands);
     nk_free(&_nk);
 }
 
 void NuklearUI::OnInputBegin()
 {
+    if (_input_replay)
+        return;
+    _stats.input_events = 0;
+    _stats.input_events_consumed = 0;
+    _stats.input_events_coalesced = 0;
+    // Windows moved during previous frame.
+    _hover_valid = false;
     nk_input_begin(&_nk);
+    if (_input_record)
+    {
+        IntVector2 size = _backend->GetSize();
+        _input_record->WriteUByte(INPUT_RECORD_FRAME);
+        _input_record->WriteFloat(_uiScale);
+        _input_record->WriteInt(size.x_);
+        _input_record->WriteInt(size.y_);
+        _recording_frame = true;
+    }
 }
 
 void NuklearUI::OnRawEvent(VariantMap& args)
 {
+    if (_input_replay)
+        return;
     auto evt = static_cast<SDL_Event*>(args[SDLRawInput::P_SDLEVENT].Get<void*>());
+    _stats.input_events++;
     switch (evt->type)
     {
     case SDL_KEYUP:
@@ -142,72 +1035,72 @@ void NuklearUI::OnRawEvent(VariantMap& args)
         {
         case SDLK_RSHIFT:
         case SDLK_LSHIFT:
-            nk_input_key(&_nk, NK_KEY_SHIFT, down);
+            InputKey(NK_KEY_SHIFT, down);
             break;
         case SDLK_DELETE:
-            nk_input_key(&_nk, NK_KEY_DEL, down);
+            InputKey(NK_KEY_DEL, down);
             break;
         case SDLK_RETURN:
-            nk_input_key(&_nk, NK_KEY_ENTER, down);
+            InputKey(NK_KEY_ENTER, down);
             break;
         case SDLK_TAB:
-            nk_input_key(&_nk, NK_KEY_TAB, down);
+            InputKey(NK_KEY_TAB, down);
             break;
         case SDLK_BACKSPACE:
-            nk_input_key(&_nk, NK_KEY_BACKSPACE, down);
+            InputKey(NK_KEY_BACKSPACE, down);
             break;
         case SDLK_HOME:
-            nk_input_key(&_nk, NK_KEY_TEXT_START, down);
-            nk_input_key(&_nk, NK_KEY_SCROLL_START, down);
+            InputKey(NK_KEY_TEXT_START, down);
+            InputKey(NK_KEY_SCROLL_START, down);
             break;
         case SDLK_END:
-            nk_input_key(&_nk, NK_KEY_TEXT_END, down);
-            nk_input_key(&_nk, NK_KEY_SCROLL_END, down);
+            InputKey(NK_KEY_TEXT_END, down);
+            InputKey(NK_KEY_SCROLL_END, down);
             break;
         case SDLK_PAGEDOWN:
-            nk_input_key(&_nk, NK_KEY_SCROLL_DOWN, down);
+            InputKey(NK_KEY_SCROLL_DOWN, down);
             break;
         case SDLK_PAGEUP:
-            nk_input_key(&_nk, NK_KEY_SCROLL_UP, down);
+            InputKey(NK_KEY_SCROLL_UP, down);
             break;
         case SDLK_z:
-            nk_input_key(&_nk, NK_KEY_TEXT_UNDO, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_TEXT_UNDO, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_r:
-            nk_input_key(&_nk, NK_KEY_TEXT_REDO, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_TEXT_REDO, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_c:
-            nk_input_key(&_nk, NK_KEY_COPY, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_COPY, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_v:
-            nk_input_key(&_nk, NK_KEY_PASTE, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_PASTE, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_x:
-            nk_input_key(&_nk, NK_KEY_CUT, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_CUT, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_b:
-            nk_input_key(&_nk, NK_KEY_TEXT_LINE_START, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_TEXT_LINE_START, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_e:
-            nk_input_key(&_nk, NK_KEY_TEXT_LINE_END, down && state[SDL_SCANCODE_LCTRL]);
+            InputKey(NK_KEY_TEXT_LINE_END, down && state[SDL_SCANCODE_LCTRL]);
             break;
         case SDLK_UP:
-            nk_input_key(&_nk, NK_KEY_UP, down);
+            InputKey(NK_KEY_UP, down);
             break;
         case SDLK_DOWN:
-            nk_input_key(&_nk, NK_KEY_DOWN, down);
+            InputKey(NK_KEY_DOWN, down);
             break;
         case SDLK_LEFT:
             if (state[SDL_SCANCODE_LCTRL])
-                nk_input_key(&_nk, NK_KEY_TEXT_WORD_LEFT, down);
+                InputKey(NK_KEY_TEXT_WORD_LEFT, down);
             else
-                nk_input_key(&_nk, NK_KEY_LEFT, down);
+                InputKey(NK_KEY_LEFT, down);
             break;
         case SDLK_RIGHT:
             if (state[SDL_SCANCODE_LCTRL])
-                nk_input_key(&_nk, NK_KEY_TEXT_WORD_RIGHT, down);
+                InputKey(NK_KEY_TEXT_WORD_RIGHT, down);
             else
-                nk_input_key(&_nk, NK_KEY_RIGHT, down);
+                InputKey(NK_KEY_RIGHT, down);
             break;
         default:
             break;
@@ -216,61 +1109,63 @@ void NuklearUI::OnRawEvent(VariantMap& args)
     }
     case SDL_MOUSEBUTTONDOWN:
     case SDL_MOUSEBUTTONUP:
-        nk_input_button(&_nk,
-                        (nk_buttons)(evt->button.button - 1),
-                        (const int)(evt->button.x / _uiScale),
-                        (const int)(evt->button.y / _uiScale),
-                        evt->type == SDL_MOUSEBUTTONDOWN);
+        // Buttons act at current mouse position.
+        FlushInput();
+        InputButton((nk_buttons)(evt->button.button - 1), (int)(evt->button.x / _uiScale),
+                    (int)(evt->button.y / _uiScale), evt->type == SDL_MOUSEBUTTONDOWN);
         break;
     case SDL_MOUSEWHEEL:
-        nk_input_scroll(&_nk, {(float)evt->wheel.x, (float)evt->wheel.y});
+        // Wheel scrolls window under current mouse position.
+        FlushMotion();
+        InputScroll((float)evt->wheel.x, (float)evt->wheel.y);
         break;
     case SDL_MOUSEMOTION:
     {
         if (_nk.input.mouse.grabbed)
         {
-            nk_input_motion(&_nk,
-                            (int)(_nk.input.mouse.prev.x + evt->motion.xrel / _uiScale),
-                            (int)(_nk.input.mouse.prev.y + evt->motion.yrel / _uiScale));
+            InputMotion((int)(_nk.input.mouse.prev.x + evt->motion.xrel / _uiScale),
+                        (int)(_nk.input.mouse.prev.y + evt->motion.yrel / _uiScale));
         }
         else
-            nk_input_motion(&_nk, (int)(evt->motion.x / _uiScale), (int)(evt->motion.y / _uiScale));
+            InputMotion((int)(evt->motion.x / _uiScale), (int)(evt->motion.y / _uiScale));
         break;
     }
     case SDL_FINGERUP:
-        nk_input_button(&_nk, NK_BUTTON_LEFT, -1, -1, 0);
+        FlushInput();
+        InputButton(NK_BUTTON_LEFT, -1, -1, 0);
         break;
     case SDL_FINGERDOWN:
-        nk_input_button(&_nk, NK_BUTTON_LEFT, (int)(evt->tfinger.x / _uiScale), (int)(evt->tfinger.y / _uiScale), 1);
+        FlushInput();
+        InputButton(NK_BUTTON_LEFT, (int)(evt->tfinger.x / _uiScale), (int)(evt->tfinger.y / _uiScale), 1);
         break;
     case SDL_FINGERMOTION:
         if (_nk.input.mouse.grabbed)
         {
-            nk_input_motion(&_nk,
-                            (int)(_nk.input.mouse.prev.x + evt->tfinger.dx / _uiScale),
-                            (int)(_nk.input.mouse.prev.y + evt->tfinger.dy / _uiScale));
+            InputMotion((int)(_nk.input.mouse.prev.x + evt->tfinger.dx / _uiScale),
+                        (int)(_nk.input.mouse.prev.y + evt->tfinger.dy / _uiScale));
         }
         else
-            nk_input_motion(&_nk, (int)(evt->tfinger.x / _uiScale), (int)(evt->tfinger.y / _uiScale));
+            InputMotion((int)(evt->tfinger.x / _uiScale), (int)(evt->tfinger.y / _uiScale));
         break;
     case SDL_TEXTINPUT:
     {
         nk_glyph glyph = {};
         memcpy(glyph, evt->text.text, NK_UTF_SIZE);
-        nk_input_glyph(&_nk, glyph);
+        InputGlyph(glyph);
         break;
     }
     default:
         break;
     }
 
+    bool consumed = false;
     switch (evt->type)
     {
     case SDL_KEYUP:
     case SDL_KEYDOWN:
     case SDL_TEXTINPUT:
         // is any item active, but not necessarily hovered.
-        args[SDLRawInput::P_CONSUMED] = (_nk.last_widget_state & NK_WIDGET_STATE_MODIFIED);
+        consumed = (_nk.last_widget_state & NK_WIDGET_STATE_MODIFIED) != 0;
         break;
     case SDL_MOUSEWHEEL:
     case SDL_MOUSEBUTTONUP:
@@ -279,142 +1174,1338 @@ void NuklearUI::OnRawEvent(VariantMap& args)
     case SDL_FINGERUP:
     case SDL_FINGERDOWN:
     case SDL_FINGERMOTION:
-        args[SDLRawInput::P_CONSUMED] = nk_window_is_any_hovered(&_nk);
+        consumed = IsAnyWindowHovered();
         break;
     default:
         break;
     }
+    // Input initializes P_CONSUMED to false.
+    if (consumed)
+    {
+        args[SDLRawInput::P_CONSUMED] = true;
+        _stats.input_events_consumed++;
+    }
 }
 
 void NuklearUI::OnInputEnd()
 {
+    if (_input_replay)
+        return;
+    FlushInput();
     nk_input_end(&_nk);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_FRAME_END);
+        _recording_frame = false;
+    }
+}
+
+void NuklearUI::InputKey(enum nk_keys key, int down)
+{
+    nk_input_key(&_nk, key, down);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_KEY);
+        _input_record->WriteUByte((unsigned char)key);
+        _input_record->WriteBool(down != 0);
+    }
+}
+
+void NuklearUI::InputButton(enum nk_buttons button, int x, int y, int down)
+{
+    nk_input_button(&_nk, button, x, y, down);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_BUTTON);
+        _input_record->WriteUByte((unsigned char)button);
+        _input_record->WriteShort((short)x);
+        _input_record->WriteShort((short)y);
+        _input_record->WriteBool(down != 0);
+    }
+}
+
+void NuklearUI::InputGlyph(const nk_glyph glyph)
+{
+    nk_input_glyph(&_nk, glyph);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_GLYPH);
+        _input_record->Write(glyph, NK_UTF_SIZE);
+    }
+}
+
+void NuklearUI::ApplyMotion(int x, int y)
+{
+    nk_input_motion(&_nk, x, y);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_MOTION);
+        _input_record->WriteShort((short)x);
+        _input_record->WriteShort((short)y);
+    }
+}
+
+void NuklearUI::ApplyScroll(struct nk_vec2 delta)
+{
+    nk_input_scroll(&_nk, delta);
+    if (_recording_frame)
+    {
+        _input_record->WriteUByte(INPUT_RECORD_SCROLL);
+        _input_record->WriteFloat(delta.x);
+        _input_record->WriteFloat(delta.y);
+    }
+}
+
+bool NuklearUI::StartInputRecording(const String& path)
+{
+    StopInputRecording();
+    SharedPtr<File> file(new File(context_, path, FILE_WRITE));
+    if (!file->IsOpen())
+    {
+        ATOMIC_LOGERROR("NuklearUI: can not open input recording " + path);
+        return false;
+    }
+    file->WriteUInt(INPUT_RECORD_MAGIC);
+    file->WriteUInt(INPUT_RECORD_VERSION);
+    // Recording starts with next frame, so that every recorded frame is complete.
+    _input_record = file;
+    _recording_frame = false;
+    return true;
+}
+
+void NuklearUI::StopInputRecording()
+{
+    if (_recording_frame)
+        _input_record->WriteUByte(INPUT_RECORD_FRAME_END);
+    _recording_frame = false;
+    _input_record.Reset();
+}
+
+bool NuklearUI::StartInputReplay(const String& path, bool loop)
+{
+    StopInputReplay();
+    SharedPtr<File> file(new File(context_, path, FILE_READ));
+    if (!file->IsOpen() || file->ReadUInt() != INPUT_RECORD_MAGIC || file->ReadUInt() != INPUT_RECORD_VERSION)
+    {
+        ATOMIC_LOGERROR("NuklearUI: can not replay input recording " + path);
+        return false;
+    }
+    // Recording and replay of the same session would feed recording into itself.
+    StopInputRecording();
+    _input_replay = file;
+    _replay_loop = loop;
+    return true;
+}
+
+void NuklearUI::StopInputReplay()
+{
+    _input_replay.Reset();
+}
+
+bool NuklearUI::ReplayInputFrame()
+{
+    if (!_input_replay)
+        return false;
+
+    if (_input_replay->IsEof())
+    {
+        if (!_replay_loop || _input_replay->GetSize() <= INPUT_RECORD_HEADER_SIZE)
+        {
+            StopInputReplay();
+            return false;
+        }
+        _input_replay->Seek(INPUT_RECORD_HEADER_SIZE);
+    }
+
+    File& file = *_input_replay;
+    if (file.ReadUByte() != INPUT_RECORD_FRAME)
+    {
+        ATOMIC_LOGERROR("NuklearUI: input recording is corrupted, replay stopped.");
+        StopInputReplay();
+        return false;
+    }
+    SetScale(file.ReadFloat());
+    _replay_viewport.x_ = file.ReadInt();
+    _replay_viewport.y_ = file.ReadInt();
+    // Headless render target emulates recorded window, so that windows are culled and clipped the same way.
+    if (_headless_backend && _backend.Get() == _headless_backend.Get() &&
+        _replay_viewport != _headless_backend->GetSize())
+    {
+        _headless_backend->SetSize(_replay_viewport);
+        UpdateProjectionMatrix();
+    }
+
+    _stats.input_events = 0;
+    _stats.input_events_consumed = 0;
+    _stats.input_events_coalesced = 0;
+    nk_input_begin(&_nk);
+    for (;;)
+    {
+        if (file.IsEof())
+        {
+            // Recording was cut in the middle of a frame.
+            break;
+        }
+        unsigned char type = file.ReadUByte();
+        if (type == INPUT_RECORD_FRAME_END)
+            break;
+        _stats.input_events++;
+        switch (type)
+        {
+        case INPUT_RECORD_KEY:
+        {
+            auto key = (enum nk_keys)file.ReadUByte();
+            nk_input_key(&_nk, key, file.ReadBool());
+            break;
+        }
+        case INPUT_RECORD_BUTTON:
+        {
+            auto button = (enum nk_buttons)file.ReadUByte();
+            int x = file.ReadShort();
+            int y = file.ReadShort();
+            nk_input_button(&_nk, button, x, y, file.ReadBool());
+            break;
+        }
+        case INPUT_RECORD_MOTION:
+        {
+            int x = file.ReadShort();
+            nk_input_motion(&_nk, x, file.ReadShort());
+            break;
+        }
+        case INPUT_RECORD_SCROLL:
+        {
+            float x = file.ReadFloat();
+            nk_input_scroll(&_nk, nk_vec2(x, file.ReadFloat()));
+            break;
+        }
+        case INPUT_RECORD_GLYPH:
+        {
+            nk_glyph glyph;
+            file.Read(glyph, NK_UTF_SIZE);
+            nk_input_glyph(&_nk, glyph);
+            break;
+        }
+        default:
+            ATOMIC_LOGERROR("NuklearUI: input recording is corrupted, replay stopped.");
+            nk_input_end(&_nk);
+            StopInputReplay();
+            return false;
+        }
+    }
+    nk_input_end(&_nk);
+    return true;
+}
+
+void NuklearUI::InputMotion(int x, int y)
+{
+    if (!_input_coalescing)
+    {
+        ApplyMotion(x, y);
+        _hover_valid = false;
+        return;
+    }
+    _stats.input_events_coalesced += _motion_pending ? 1 : 0;
+    if (!_motion_pending || _motion_x != x || _motion_y != y)
+        _hover_valid = false;
+    _motion_pending = true;
+    _motion_x = x;
+    _motion_y = y;
+}
+
+void NuklearUI::InputScroll(float x, float y)
+{
+    if (!_input_coalescing)
+    {
+        ApplyScroll(nk_vec2(x, y));
+        return;
+    }
+    // nuklear sums scroll deltas of a frame anyway.
+    _stats.input_events_coalesced += _scroll_pending.x != 0 || _scroll_pending.y != 0 ? 1 : 0;
+    _scroll_pending.x += x;
+    _scroll_pending.y += y;
+}
+
+void NuklearUI::FlushInput()
+{
+    FlushMotion();
+    if (_scroll_pending.x != 0 || _scroll_pending.y != 0)
+    {
+        ApplyScroll(_scroll_pending);
+        _scroll_pending = nk_vec2(0, 0);
+    }
+}
+
+void NuklearUI::FlushMotion()
+{
+    if (_motion_pending)
+    {
+        // Hover was already tested at this position.
+        ApplyMotion(_motion_x, _motion_y);
+        _motion_pending = false;
+    }
+}
+
+bool NuklearUI::IsAnyWindowHovered()
+{
+    if (!_hover_valid)
+    {
+        // Pending motion is tested without applying it, nuklear reads only mouse position in hover tests.
+        struct nk_vec2 pos = _nk.input.mouse.pos;
+        if (_motion_pending)
+            _nk.input.mouse.pos = nk_vec2((float)_motion_x, (float)_motion_y);
+        _hovered = nk_window_is_any_hovered(&_nk) != 0;
+        _nk.input.mouse.pos = pos;
+        _hover_valid = true;
+    }
+    return _hovered;
+}
+
+void NuklearUI::OnEndRendering()
+{
+    // Engine does not render when window is closed or device is lost
+    assert(_graphics && _graphics->IsInitialized() && !_graphics->IsDeviceLost());
+    Render();
+}
+
+void NuklearUI::Render()
+{
+    ATOMIC_PROFILE(NuklearRenderDrawLists);
+
+    bool ready;
+    if (_staged_pending)
+        ready = EndStagedConvert();
+    else
+    {
+        ResetFrameStats();
+        ready = ConvertFrame();
+    }
+
+    if (!ready)
+    {
+        // Never draw partial geometry. Cached windows that were not redrawn are retried next frame.
+        for (auto& it : _window_caches)
+        {
+            if (it.second_.redraw)
+                it.second_.hash = 0;
+        }
+        UpdateMemoryStats();
+        nk_clear(&_nk);
+        SendStatsEvent();
+        return;
+    }
+
+    HiresTimer timer;
+    {
+        ATOMIC_PROFILE(NuklearSubmit);
+        _stats.draw_calls = 0;
+        _stats.state_changes = 0;
+        bool target_changed = false;
+        for (auto& it : _window_caches)
+        {
+            NuklearWindowCache& cache = it.second_;
+            if (!cache.redraw)
+                continue;
+            _backend->SetRenderTarget(cache.texture);
+            _backend->Submit(cache.commands, _frame_vertex_count, cache.projection, _stats);
+            cache.redraw = false;
+            target_changed = true;
+        }
+        if (target_changed)
+            _backend->SetRenderTarget(0);
+        _backend->Submit(_draw_commands, _frame_vertex_count, _projection, _stats);
+    }
+    _stats.submit_time_us = (unsigned)timer.GetUSec(true);
+    _stats.vertex_count = _frame_vertex_count;
+    _stats.index_count = _frame_index_count;
+    _stats.vertex_chunks = _vertex_chunks.commands.Size() + 1;
+    _stats.large_indices = sizeof(nk_draw_index) > 2;
+    _stats.packed_vertices = _packed_active;
+    TrimBuffers(_frame_vertex_count, _frame_index_count);
+    // Frames reusing previous geometry say nothing about conversion cost.
+    if (_stats.convert_time_us)
+        UpdateQualityGovernor();
+
+    UpdateMemoryStats();
+    nk_clear(&_nk);
+    SendStatsEvent();
+}
+
+void NuklearUI::ResetFrameStats()
+{
+    _stats.convert_time_us = 0;
+    _stats.lock_time_us = 0;
+    _stats.record_time_us = 0;
+    _stats.glyph_upload_time_us = 0;
+    _stats.window_redraws = 0;
+    _stats.upload_bytes = 0;
+}
+
+bool NuklearUI::ConvertFrame()
+{
+    UpdateVertexFormat();
+    if (_backend->CheckDataLost())
+        _frame_cache_valid = false;
+
+    // Fingerprint of custom commands covers only callback pointers. Frame is identical to previous one, which tells
+    // whether it contains them.
+    if (UpdateFrameFingerprint() && _frame_cache_valid && !_frame_has_custom)
+    {
+        _stats.frame_cache_hits++;
+        return true;
+    }
+    if (_frame_cache_enabled)
+        _stats.frame_cache_misses++;
+
+    for (auto& font : _dynamic_fonts)
+        font->BeginFrame();
+    CollectCommandSegments();
+    UpdateWindowCaches();
+
+    // Packed vertices are converted into memory, because nuklear can write only float positions.
+    bool staged = _packed_active;
+    if (staged)
+        ReserveStagedGeometry();
+    HiresTimer timer;
+    {
+        ATOMIC_PROFILE(NuklearConvert);
+        _frame_cache_valid = TessellateAndConvert(staged, false);
+    }
+    _stats.convert_time_us = (unsigned)timer.GetUSec(true);
+    if (!_frame_cache_valid)
+        return false;
+
+    {
+        ATOMIC_PROFILE(NuklearRecordDrawCommands);
+        RecordDrawCommands();
+    }
+    _stats.record_time_us = (unsigned)timer.GetUSec(true);
+    if (staged)
+    {
+        UploadStagedGeometry();
+        _stats.convert_time_us += _stats.lock_time_us;
+        // Buffers may have grown during upload, but they hold current frame.
+        _frame_cache_valid = true;
+    }
+    UploadGlyphs();
+    return true;
+}
+
+void NuklearUI::UploadGlyphs()
+{
+    // Glyphs first seen by conversion were rasterized into CPU copy of the texture.
+    if (_dynamic_fonts.Empty())
+        return;
+
+    ATOMIC_PROFILE(NuklearUploadGlyphs);
+    HiresTimer timer;
+    for (auto& font : _dynamic_fonts)
+        font->UploadDirtyRegion();
+    _stats.glyph_upload_time_us = (unsigned)timer.GetUSec(false);
+}
+
+void NuklearUI::SetPipelined(bool enable)
+{
+    if (enable && !GetSubsystem<WorkQueue>())
+    {
+        ATOMIC_LOGWARNING("NuklearUI: pipelined conversion requires WorkQueue subsystem.");
+        return;
+    }
+    _pipelined = enable;
+}
+
+void NuklearUI::BeginStagedConvert()
+{
+    // Conversion of previous frame was not consumed, for example because nothing was rendered.
+    if (_convert_item)
+    {
+        GetSubsystem<WorkQueue>()->Complete(M_MAX_UNSIGNED);
+        _convert_item.Reset();
+    }
+    _staged_pending = false;
+
+    ResetFrameStats();
+    UpdateVertexFormat();
+    if (_backend->CheckDataLost())
+        _frame_cache_valid = false;
+    // Render() will find out that frame did not change on its own.
+    if (UpdateFrameFingerprint() && _frame_cache_valid && !_frame_has_custom)
+        return;
+    if (_frame_cache_enabled)
+        _stats.frame_cache_misses++;
+
+    // Everything that touches GPU resources happens here, worker only tessellates into memory.
+    for (auto& font : _dynamic_fonts)
+        font->BeginFrame();
+    CollectCommandSegments();
+    UpdateWindowCaches();
+    ReserveStagedGeometry();
+    _staged_size = _backend->GetSize();
+    _staged_pending = true;
+
+    if (_frame_has_custom)
+    {
+        // Custom commands call user code, which may run only on main thread. Such frames are converted right away.
+        ConvertStaged(false);
+        return;
+    }
+
+    _convert_item = new WorkItem();
+    _convert_item->workFunction_ = &NuklearUI::StagedConvertWork;
+    _convert_item->aux_ = this;
+    _convert_item->priority_ = M_MAX_UNSIGNED;
+    _convert_item->sendEvent_ = false;
+    GetSubsystem<WorkQueue>()->AddWorkItem(_convert_item);
+}
+
+void NuklearUI::StagedConvertWork(const WorkItem* item, unsigned threadIndex)
+{
+    static_cast<NuklearUI*>(item->aux_)->ConvertStaged(true);
+}
+
+void NuklearUI::ConvertStaged(bool worker)
+{
+    HiresTimer timer;
+    _staged_result = TessellateAndConvert(true, worker);
+    _stats.convert_time_us = (unsigned)timer.GetUSec(true);
+    if (_staged_result)
+    {
+        RecordDrawCommands();
+        _stats.record_time_us = (unsigned)timer.GetUSec(false);
+    }
+}
+
+bool NuklearUI::EndStagedConvert()
+{
+    if (_convert_item)
+    {
+        ATOMIC_PROFILE(NuklearWaitConvert);
+        GetSubsystem<WorkQueue>()->Complete(M_MAX_UNSIGNED);
+        _convert_item.Reset();
+    }
+    _staged_pending = false;
+    if (!_staged_result)
+    {
+        _frame_cache_valid = false;
+        return false;
+    }
+
+    UploadStagedGeometry();
+    _frame_cache_valid = true;
+    UploadGlyphs();
+    return true;
+}
+
+bool NuklearUI::ConvertStagedGeometry()
+{
+    static const unsigned MAX_CONVERT_ATTEMPTS = 8;
+    for (unsigned attempt = 0; attempt < MAX_CONVERT_ATTEMPTS; attempt++)
+    {
+        unsigned vertex_count = _staged_vertices.Size() / _config.vertex_size;
+        unsigned index_count = _staged_indices.Size() / (unsigned)sizeof(nk_draw_index);
+        nk_flags result = ConvertGeometry(&_staged_vertices.Front(), vertex_count, &_staged_indices.Front(), index_count);
+        if (result & NK_CONVERT_COMMAND_BUFFER_FULL)
+            return false;
+        if (!(result & (NK_CONVERT_VERTEX_BUFFER_FULL | NK_CONVERT_ELEMENT_BUFFER_FULL)))
+            return true;
+
+        if (result & NK_CONVERT_VERTEX_BUFFER_FULL)
+            _staged_vertices.Resize(vertex_count * _config.vertex_size);
+        if (result & NK_CONVERT_ELEMENT_BUFFER_FULL)
+            _staged_indices.Resize(index_count * (unsigned)sizeof(nk_draw_index));
+    }
+
+    ATOMIC_LOGERROR("NuklearUI: UI geometry does not fit into vertex/index buffers, frame skipped.");
+    return false;
+}
+
+void NuklearUI::ReserveStagedGeometry()
+{
+    if (!_staged_vertices.Empty())
+        return;
+    _staged_vertices.Resize(Max(_backend->GetVertexCapacity(), 1u) * _config.vertex_size);
+    _staged_indices.Resize(Max(_backend->GetIndexCapacity(), 1u) * (unsigned)sizeof(nk_draw_index));
+}
+
+void NuklearUI::UploadStagedGeometry()
+{
+    unsigned vertex_capacity = _backend->GetVertexCapacity();
+    unsigned index_capacity = _backend->GetIndexCapacity();
+    if (_frame_vertex_count > vertex_capacity || _frame_index_count > index_capacity)
+    {
+        ReallocateBuffers(_frame_vertex_count > vertex_capacity ? Max(_frame_vertex_count, vertex_capacity * 2) : 0,
+                          _frame_index_count > index_capacity ? Max(_frame_index_count, index_capacity * 2) : 0);
+        _buffer_oversized_frames = 0;
+        _buffer_peak_vertices = 0;
+        _buffer_peak_indices = 0;
+    }
+
+    // Empty frame draws nothing, graphics buffers can not lock empty ranges.
+    if (!_frame_vertex_count || !_frame_index_count)
+        return;
+
+    HiresTimer timer;
+    ATOMIC_PROFILE(NuklearUploadGeometry);
+    void* vertexData;
+    void* indexData;
+    bool locked = _backend->Lock(vertexData, _frame_vertex_count, indexData, _frame_index_count);
+    assert(locked);
+    (void)locked;
+    unsigned vertex_size = _packed_active ? (unsigned)sizeof(nk_sdl_packed_vertex) : (unsigned)_config.vertex_size;
+    _stats.upload_bytes += _frame_vertex_count * vertex_size + _frame_index_count * (unsigned)sizeof(nk_draw_index);
+    if (_packed_active)
+        PackVertices(vertexData, &_staged_vertices.Front(), _frame_vertex_count);
+    else
+        memcpy(vertexData, &_staged_vertices.Front(), _frame_vertex_count * _config.vertex_size);
+    memcpy(indexData, &_staged_indices.Front(), _frame_index_count * sizeof(nk_draw_index));
+    _backend->Unlock();
+    _stats.lock_time_us = (unsigned)timer.GetUSec(false);
+}
+
+void NuklearUI::UpdateVertexFormat()
+{
+    IntVector2 size = _backend->GetSize();
+    bool packed = _packed_vertices && _backend->SupportsPackedVertices() &&
+                  Max(size.x_, size.y_) / _uiScale <= PACKED_MAX_EXTENT &&
+                  Max(_stats.atlas_width, _stats.atlas_height) <= PACKED_MAX_TEXTURE_SIZE;
+    if (packed == _packed_active)
+        return;
+
+    _packed_active = packed;
+    _vertex_elements.Clear();
+    if (packed)
+    {
+        // Graphics has no 16-bit vertex element types, pairs of 16-bit values are read as bytes and joined by shader.
+        _vertex_elements.Push(VertexElement(TYPE_UBYTE4, SEM_POSITION));
+        _vertex_elements.Push(VertexElement(TYPE_UBYTE4, SEM_TEXCOORD));
+    }
+    else
+    {
+        _vertex_elements.Push(VertexElement(TYPE_VECTOR2, SEM_POSITION));
+        _vertex_elements.Push(VertexElement(TYPE_VECTOR2, SEM_TEXCOORD));
+    }
+    _vertex_elements.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
+    if (_backend->GetVertexCapacity())
+        ReallocateBuffers(_backend->GetVertexCapacity(), 0);
+}
+
+void NuklearUI::SendStatsEvent()
+{
+    if (!_stats_event_enabled)
+        return;
+
+    using namespace NuklearStats;
+    VariantMap& args = GetEventDataMap();
+    args[P_STATS] = (void*)&_stats;
+    SendEvent(E_NUKLEARSTATS, args);
+}
+
+bool NuklearUI::ConvertDrawLists()
+{
+    static const unsigned MAX_CONVERT_ATTEMPTS = 8;
+    // Geometry size is known only after conversion. Counts of previous frame with a quarter of headroom are locked,
+    // whole buffers are locked when frame outgrows them. 0 locks whole buffer.
+    unsigned lock_vertices = _frame_vertex_count + _frame_vertex_count / 4;
+    unsigned lock_indices = _frame_index_count + _frame_index_count / 4;
+    for (unsigned attempt = 0; attempt < MAX_CONVERT_ATTEMPTS; attempt++)
+    {
+        unsigned vertex_capacity = _backend->GetVertexCapacity();
+        unsigned index_capacity = _backend->GetIndexCapacity();
+        unsigned locked_vertices = lock_vertices && lock_vertices < vertex_capacity ? lock_vertices : vertex_capacity;
+        unsigned locked_indices = lock_indices && lock_indices < index_capacity ? lock_indices : index_capacity;
+        void* vertexData;
+        void* indexData;
+        HiresTimer lock_timer;
+        {
+            ATOMIC_PROFILE(NuklearLockBuffers);
+            bool locked = _backend->Lock(vertexData, locked_vertices, indexData, locked_indices);
+            assert(locked);
+            (void)locked;
+        }
+        _stats.lock_time_us += (unsigned)lock_timer.GetUSec(false);
+
+        // Locked ranges are uploaded whole, even when frame did not fill them.
+        _stats.upload_bytes += locked_vertices * _config.vertex_size + locked_indices * (unsigned)sizeof(nk_draw_index);
+        unsigned vertex_count = locked_vertices;
+        unsigned index_count = locked_indices;
+        nk_flags result = ConvertGeometry(vertexData, vertex_count, indexData, index_count);
+
+        lock_timer.Reset();
+        {
+            ATOMIC_PROFILE(NuklearUnlockBuffers);
+            _backend->Unlock();
+        }
+        _stats.lock_time_us += (unsigned)lock_timer.GetUSec(false);
+
+        if (result & NK_CONVERT_COMMAND_BUFFER_FULL)
+            return false;
+        if (!(result & (NK_CONVERT_VERTEX_BUFFER_FULL | NK_CONVERT_ELEMENT_BUFFER_FULL)))
+            return true;
+
+        // Buffers grow only when geometry did not fit even though they were locked whole.
+        lock_vertices = 0;
+        lock_indices = 0;
+        bool grow_vertices = (result & NK_CONVERT_VERTEX_BUFFER_FULL) && locked_vertices == vertex_capacity;
+        bool grow_indices = (result & NK_CONVERT_ELEMENT_BUFFER_FULL) && locked_indices == index_capacity;
+        if (grow_vertices || grow_indices)
+        {
+            ReallocateBuffers(grow_vertices ? vertex_count : 0, grow_indices ? index_count : 0);
+            _buffer_oversized_frames = 0;
+            _buffer_peak_vertices = 0;
+            _buffer_peak_indices = 0;
+        }
+    }
+
+    ATOMIC_LOGERROR("NuklearUI: UI geometry does not fit into vertex/index buffers, frame skipped.");
+    return false;
+}
+
+nk_flags NuklearUI::ConvertGeometry(void* vertices, unsigned& vertex_count, void* indices, unsigned& index_count)
+{
+    struct nk_buffer vbuf, ebuf;
+    nk_buffer_init_fixed(&vbuf, vertices, vertex_count * _config.vertex_size);
+    nk_buffer_init_fixed(&ebuf, indices, index_count * sizeof(nk_draw_index));
+    // Draw commands of previous frame or failed attempt must not pile up.
+    nk_buffer_clear(&_commands);
+    nk_flags result = ConvertSegments(&vbuf, &ebuf);
+    // Geometry buffers go out of scope, draw list must not reference them.
+    _nk.draw_list.vertices = 0;
+    _nk.draw_list.elements = 0;
+#if NKUI_HALF_PIXEL_OFFSET && NKUI_GENERIC_VERTEX_OUTPUT
+    for (unsigned i = 0; i < _vertex_chunks.base + _nk.draw_list.vertex_count; i++)
+    {
+        nk_sdl_vertex* v = (nk_sdl_vertex*)vertices + i;
+        v->position[0] += 0.5f;
+        v->position[1] += 0.5f;
+    }
+#endif
+
+    _stats.command_memory_peak = Max(_stats.command_memory_peak, (unsigned)_commands.needed);
+    if (result & NK_CONVERT_COMMAND_BUFFER_FULL)
+    {
+        // Fixed draw command budget can not grow.
+        _stats.command_memory_overflows++;
+        ATOMIC_LOGERROR("NuklearUI: draw commands do not fit into command memory budget, frame skipped.");
+        return result;
+    }
+
+    // nk_convert() drops primitives that do not fit, so `needed` is only a lower bound of required memory. Buffers
+    // are grown at least twice in order to converge quickly, then conversion is retried in the same frame.
+    if (result & NK_CONVERT_VERTEX_BUFFER_FULL)
+        vertex_count = Max((unsigned)(vbuf.needed / _config.vertex_size), vertex_count) * 2;
+    if (result & NK_CONVERT_ELEMENT_BUFFER_FULL)
+        index_count = Max((unsigned)(ebuf.needed / sizeof(nk_draw_index)), index_count) * 2;
+    return result;
+}
+
+void NuklearUI::CollectCommandSegments()
+{
+    _segments.Clear();
+    _frame_has_custom = false;
+
+    // Window hashes are needed only for reusing window geometry or textures. Conversion settings are part of them.
+    bool hash = _retained_geometry || !_window_caches.Empty();
+    unsigned long long seed = HashValue(HashValue(14695981039346656037ull, _config), GetAdaptiveScale());
+
+    // Commands of visible windows are linked in window order, followed by popups and overlay.
+    const nk_byte* memory = static_cast<const nk_byte*>(_nk.memory.memory.ptr);
+    struct nk_window* window = _nk.begin;
+    NuklearCommandSegment* segment = 0;
+    for (const struct nk_command* cmd = nk__begin(&_nk); cmd; cmd = nk__next(&_nk, cmd))
+    {
+        nk_size offset = (nk_size)((const nk_byte*)cmd - memory);
+        while (window && (window->buffer.last == window->buffer.begin || (window->flags & NK_WINDOW_HIDDEN) ||
+               window->seq != _nk.seq || window->buffer.begin < offset))
+            window = window->next;
+
+        if (window && window->buffer.begin == offset)
+        {
+            _segments.Push(NuklearCommandSegment{window, cmd, cmd, seed});
+            segment = &_segments.Back();
+            window = window->next;
+        }
+        else if (!segment || (segment->window && segment->last == nk_ptr_add_const(struct nk_command, memory,
+                                                                                     segment->window->buffer.last)))
+        {
+            _segments.Push(NuklearCommandSegment{0, cmd, cmd, seed});
+            segment = &_segments.Back();
+        }
+        else
+            segment->last = cmd;
+
+        if (hash)
+            segment->hash = HashCommand(segment->hash, cmd);
+        if (cmd->type == NK_COMMAND_CUSTOM)
+        {
+            segment->custom = true;
+            _frame_has_custom = true;
+        }
+    }
+}
+
+void NuklearUI::UpdateWindowCaches()
+{
+    for (auto& it : _window_caches)
+        it.second_.redraw = false;
+    if (_window_caches.Empty())
+        return;
+
+    for (const NuklearCommandSegment& segment : _segments)
+    {
+        if (!segment.window)
+            continue;
+        auto it = _window_caches.Find(segment.window->name);
+        if (it == _window_caches.End())
+            continue;
+
+        NuklearWindowCache& cache = it->second_;
+        unsigned long long hash = segment.hash;
+        struct nk_rect bounds = segment.window->bounds;
+        IntVector2 size(Max((int)Ceil(bounds.w * _uiScale), 1), Max((int)Ceil(bounds.h * _uiScale), 1));
+        Texture2D* texture = cache.texture;
+        // Hover highlights are part of commands, but input also triggers redraw so that widget state is never stale.
+        bool receives_input = _stats.input_events && nk_input_is_mouse_hovering_rect(&_nk.input, bounds);
+        cache.redraw = hash != cache.hash || segment.custom || receives_input || texture->IsDataLost() ||
+                       cache.size != size;
+        if (!cache.redraw)
+            continue;
+
+        if (cache.size != size)
+        {
+            texture->SetNumLevels(1);
+            if (_graphics)
+                texture->SetSize(size.x_, size.y_, Graphics::GetRGBAFormat(), TEXTURE_RENDERTARGET);
+            cache.size = size;
+        }
+        texture->ClearDataLost();
+        cache.hash = hash;
+        cache.bounds = bounds;
+        cache.projection = MakeProjection(Vector2(bounds.x, bounds.y), size, true);
+        _stats.window_redraws++;
+    }
+}
+
+void NuklearUI::PrepareSegments(bool allow_parallel)
+{
+    _stats.parallel_segments = 0;
+    _stats.retained_segments = 0;
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    bool parallel = allow_parallel && _parallel_tessellation && queue && queue->GetNumThreads() && _segments.Size() > 1;
+    if (!parallel && !_retained_geometry)
+        return;
+
+    ATOMIC_PROFILE(NuklearTessellate);
+    _retained_frame++;
+    PODVector<NuklearSegmentTessellator*> pending;
+    unsigned pool_used = 0;
+    for (NuklearCommandSegment& segment : _segments)
+    {
+        if (segment.window && !_window_caches.Empty())
+        {
+            auto it = _window_caches.Find(segment.window->name);
+            if (it != _window_caches.End() && !it->second_.redraw)
+                continue;
+        }
+
+        if (_retained_geometry && segment.window)
+        {
+            SharedPtr<NuklearSegmentTessellator>& retained = _retained_segments[segment.window->name];
+            if (!retained)
+                retained = new NuklearSegmentTessellator();
+            retained->SetLastUsed(_retained_frame);
+            segment.tessellator = retained;
+            if (!segment.custom && retained->IsComplete() && retained->GetHash() == segment.hash)
+            {
+                _stats.retained_segments++;
+                continue;
+            }
+        }
+        else if (parallel)
+        {
+            if (pool_used == _tessellators.Size())
+                _tessellators.Push(SharedPtr<NuklearSegmentTessellator>(new NuklearSegmentTessellator()));
+            segment.tessellator = _tessellators[pool_used++];
+        }
+        else
+            continue;
+
+        segment.tessellator->Setup(&_nk, segment, &_config, GetAdaptiveScale(), _vertex_chunks.enabled);
+        pending.Push(segment.tessellator);
+    }
+
+    // Geometry of windows that were closed or hidden is released.
+    for (auto it = _retained_segments.Begin(); it != _retained_segments.End();)
+    {
+        if (it->second_->GetLastUsed() != _retained_frame)
+            it = _retained_segments.Erase(it);
+        else
+            ++it;
+    }
+
+    if (parallel && pending.Size() > 1)
+    {
+        for (NuklearSegmentTessellator* tessellator : pending)
+        {
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->workFunction_ = &TessellateWork;
+            item->aux_ = tessellator;
+            item->priority_ = M_MAX_UNSIGNED;
+            item->sendEvent_ = false;
+            queue->AddWorkItem(item);
+        }
+        _stats.parallel_segments = pending.Size();
+        queue->Complete(M_MAX_UNSIGNED);
+    }
+
+    // Custom commands call user code, their segments are finished on main thread.
+    for (NuklearSegmentTessellator* tessellator : pending)
+    {
+        if (!tessellator->IsComplete())
+            tessellator->Tessellate(true);
+    }
+}
+
+bool NuklearUI::TessellateAndConvert(bool staged, bool worker)
+{
+    unsigned evictions = GetGlyphEvictions();
+    PrepareSegments(!worker);
+    bool result = staged ? ConvertStagedGeometry() : ConvertDrawLists();
+    if (result && _stats.retained_segments && GetGlyphEvictions() != evictions)
+    {
+        // Glyphs evicted by this frame may be referenced by reused geometry, tessellate all windows again. Glyphs used
+        // by current frame are never evicted, so second attempt is consistent.
+        InvalidateRetainedGeometry();
+        PrepareSegments(!worker);
+        result = staged ? ConvertStagedGeometry() : ConvertDrawLists();
+    }
+    return result;
 }
 
-void NuklearUI::OnEndRendering()
+unsigned NuklearUI::GetGlyphEvictions() const
 {
-    ATOMIC_PROFILE(NuklearRenderDrawLists);
-    // Engine does not render when window is closed or device is lost
-    assert(_graphics && _graphics->IsInitialized() && !_graphics->IsDeviceLost());
+    unsigned evictions = 0;
+    for (const auto& font : _dynamic_fonts)
+        evictions += font->GetEvictions();
+    return evictions;
+}
 
-    // Max. vertex / index count is not assumed to change later
-    void* vertexData = _vertex_buffer->Lock(0, _vertex_buffer->GetVertexCount(), true);
-    void* indexData = _index_buffer->Lock(0, _index_buffer->GetIndexCount(), true);
-    assert(vertexData && indexData);
+/// Tessellation settings of governor quality levels, from best to cheapest.
+static const struct
+{
+    unsigned segments;
+    enum nk_anti_aliasing shape_AA;
+    enum nk_anti_aliasing line_AA;
+} QUALITY_LEVELS[] = {
+    {22, NK_ANTI_ALIASING_ON, NK_ANTI_ALIASING_ON},
+    {16, NK_ANTI_ALIASING_ON, NK_ANTI_ALIASING_ON},
+    {12, NK_ANTI_ALIASING_ON, NK_ANTI_ALIASING_ON},
+    {12, NK_ANTI_ALIASING_OFF, NK_ANTI_ALIASING_ON},
+    {12, NK_ANTI_ALIASING_OFF, NK_ANTI_ALIASING_OFF},
+};
+static const unsigned NUM_QUALITY_LEVELS = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
 
-    struct nk_buffer vbuf, ebuf;
-    nk_buffer_init_fixed(&vbuf, vertexData, _vertex_buffer->GetVertexCount() * _vertex_buffer->GetVertexSize());
-    nk_buffer_init_fixed(&ebuf, indexData, _index_buffer->GetIndexCount() * _index_buffer->GetIndexSize());
-    nk_flags result = nk_convert(&_nk, &_commands, &vbuf, &ebuf, &_config);
-#if (defined(_WIN32) && !defined(ATOMIC_D3D11) && !defined(ATOMIC_OPENGL)) || defined(ATOMIC_D3D9)
-    for (int i = 0; i < _vertex_buffer->GetVertexCount(); i++)
+void NuklearUI::SetAdaptiveTessellation(bool enable)
+{
+    _adaptive_tessellation = enable;
+    _frame_cache_valid = false;
+}
+
+void NuklearUI::SetTessellationBudget(unsigned convert_time_us, unsigned vertex_count)
+{
+    _budget_convert_time_us = convert_time_us;
+    _budget_vertices = vertex_count;
+    _budget_over_frames = 0;
+    _budget_under_frames = 0;
+    if (!convert_time_us && !vertex_count)
+        SetQualityLevel(0);
+}
+
+void NuklearUI::SetQualityLevel(unsigned level)
+{
+    level = Min(level, NUM_QUALITY_LEVELS - 1);
+    _stats.quality_level = level;
+    _config.circle_segment_count = QUALITY_LEVELS[level].segments;
+    _config.curve_segment_count = QUALITY_LEVELS[level].segments;
+    _config.arc_segment_count = QUALITY_LEVELS[level].segments;
+    _config.shape_AA = QUALITY_LEVELS[level].shape_AA;
+    _config.line_AA = QUALITY_LEVELS[level].line_AA;
+    // Frame cache compares commands only.
+    _frame_cache_valid = false;
+}
+
+void NuklearUI::UpdateQualityGovernor()
+{
+    // Quality is lowered quickly when over budget, and raised slowly only when there is plenty of headroom, so that
+    // it does not oscillate between two levels.
+    static const unsigned STEP_DOWN_FRAMES = 3;
+    static const unsigned STEP_UP_FRAMES = 60;
+    static const float STEP_UP_HEADROOM = 0.6f;
+    if (!_budget_convert_time_us && !_budget_vertices)
+        return;
+
+    bool over = (_budget_convert_time_us && _stats.convert_time_us > _budget_convert_time_us) ||
+                (_budget_vertices && _stats.vertex_count > _budget_vertices);
+    bool under = (!_budget_convert_time_us || _stats.convert_time_us < _budget_convert_time_us * STEP_UP_HEADROOM) &&
+                 (!_budget_vertices || _stats.vertex_count < _budget_vertices * STEP_UP_HEADROOM);
+    _budget_over_frames = over ? _budget_over_frames + 1 : 0;
+    _budget_under_frames = under ? _budget_under_frames + 1 : 0;
+
+    if (_budget_over_frames >= STEP_DOWN_FRAMES && _stats.quality_level + 1 < NUM_QUALITY_LEVELS)
     {
-        nk_sdl_vertex* v = (nk_sdl_vertex*)vertexData + i;
-        v->position[0] += 0.5f;
-        v->position[1] += 0.5f;
+        SetQualityLevel(_stats.quality_level + 1);
+        _budget_over_frames = 0;
     }
-#endif
-    _vertex_buffer->Unlock();
-    _index_buffer->Unlock();
-
-    _graphics->ClearParameterSources();
-    _graphics->SetColorWrite(true);
-    _graphics->SetCullMode(CULL_NONE);
-    _graphics->SetDepthTest(CMP_ALWAYS);
-    _graphics->SetDepthWrite(false);
-    _graphics->SetFillMode(FILL_SOLID);
-    _graphics->SetStencilTest(false);
-    _graphics->SetVertexBuffer(_vertex_buffer);
-    _graphics->SetIndexBuffer(_index_buffer);
+    else if (_budget_under_frames >= STEP_UP_FRAMES && _stats.quality_level > 0)
+    {
+        SetQualityLevel(_stats.quality_level - 1);
+        _budget_under_frames = 0;
+    }
+}
 
+void NuklearUI::SetRetainedGeometry(bool enable)
+{
+    _retained_geometry = enable;
+    InvalidateRetainedGeometry();
+}
+
+void NuklearUI::InvalidateRetainedGeometry()
+{
+    _retained_segments.Clear();
+    _frame_cache_valid = false;
+}
+
+nk_flags NuklearUI::ConvertSegments(struct nk_buffer* vertices, struct nk_buffer* elements)
+{
+    struct nk_draw_list* list = &_nk.draw_list;
+    nk_draw_list_setup(list, &_config, &_commands, vertices, elements, _config.line_AA, _config.shape_AA);
+    ClearVertexChunks(_vertex_chunks);
+    for (const NuklearCommandSegment& segment : _segments)
+    {
+        NuklearWindowCache* cache = 0;
+        if (segment.window && !_window_caches.Empty())
+        {
+            auto it = _window_caches.Find(segment.window->name);
+            if (it != _window_caches.End())
+                cache = &it->second_;
+        }
+
+        if (!cache || cache->redraw)
+        {
+            // Geometry of redrawn windows has to end up in separate draw commands, they go to another target.
+            if (cache)
+                cache->command_start = SplitDrawList(list);
+            if (segment.tessellator)
+                segment.tessellator->AppendTo(list, _vertex_chunks);
+            else
+            {
+                for (const struct nk_command* cmd = segment.first;; cmd = nk__next(&_nk, cmd))
+                {
+                    ReserveVertices(list, _vertex_chunks, EstimateVertexCount(cmd, _config));
+                    ConvertCommand(list, cmd, _config, GetAdaptiveScale());
+                    if (cmd == segment.last)
+                        break;
+                }
+            }
+            if (cache)
+                cache->command_end = SplitDrawList(list);
+        }
+
+        if (cache && cache->composite)
+        {
+            struct nk_rect clip = list->cmd_count ? nk_draw_list_command_last(list)->clip_rect : nk_null_rect;
+            ReserveVertices(list, _vertex_chunks, 4);
+            nk_draw_list_add_clip(list, nk_null_rect);
+            nk_draw_list_add_image(list, nk_image_ptr(cache->texture.Get()), cache->bounds, nk_rgba(255, 255, 255, 255));
+            nk_draw_list_add_clip(list, clip);
+        }
+    }
+
+    nk_flags result = NK_CONVERT_SUCCESS;
+    if (_commands.needed > _commands.allocated + (_commands.memory.size - _commands.size))
+        result |= NK_CONVERT_COMMAND_BUFFER_FULL;
+    if (vertices->needed > vertices->allocated)
+        result |= NK_CONVERT_VERTEX_BUFFER_FULL;
+    if (elements->needed > elements->allocated)
+        result |= NK_CONVERT_ELEMENT_BUFFER_FULL;
+    return result;
+}
+
+void NuklearUI::RecordDrawCommands()
+{
+    _draw_commands.Clear();
+    for (auto& it : _window_caches)
+        it.second_.commands.Clear();
+    _frame_vertex_count = _vertex_chunks.base + _nk.draw_list.vertex_count;
+    _frame_index_count = _nk.draw_list.element_count;
+    _stats.nk_draw_commands = 0;
+    _stats.culled_commands = 0;
+
+    // Draw commands of redrawn windows are routed to their textures. Segments are in draw command order.
+    PODVector<NuklearWindowCache*> targets;
+    for (const NuklearCommandSegment& segment : _segments)
+    {
+        auto it = segment.window ? _window_caches.Find(segment.window->name) : _window_caches.End();
+        if (it != _window_caches.End() && it->second_.redraw)
+            targets.Push(&it->second_);
+    }
+
+    // Backend is not touched from worker thread.
+    IntVector2 size = _convert_item ? _staged_size : _backend->GetSize();
     unsigned index = 0;
+    unsigned cmd_index = 0;
+    unsigned target_index = 0;
+    unsigned chunk_index = 0;
     const struct nk_draw_command* cmd;
     nk_draw_foreach(cmd, &_nk, &_commands)
     {
+        while (chunk_index < _vertex_chunks.commands.Size() && cmd_index >= _vertex_chunks.commands[chunk_index])
+            chunk_index++;
+        unsigned vertex_start = chunk_index ? _vertex_chunks.vertices[chunk_index - 1] : 0;
+        while (target_index < targets.Size() && cmd_index >= targets[target_index]->command_end)
+            target_index++;
+        NuklearWindowCache* target = 0;
+        if (target_index < targets.Size() && cmd_index >= targets[target_index]->command_start)
+            target = targets[target_index];
+        cmd_index++;
+
+        _stats.nk_draw_commands++;
         if (!cmd->elem_count)
             continue;
 
-        ShaderVariation* ps;
-        ShaderVariation* vs;
-
-        Texture2D* texture = static_cast<Texture2D*>(cmd->texture.ptr);
-        if (!texture)
+        unsigned index_start = index;
+        index += cmd->elem_count;
+        if (target)
         {
-            ps = _graphics->GetShader(PS, "Basic", "VERTEXCOLOR");
-            vs = _graphics->GetShader(VS, "Basic", "VERTEXCOLOR");
+            RecordDrawCommand(target->commands, cmd, index_start, vertex_start,
+                              Vector2(target->bounds.x, target->bounds.y), target->size);
         }
         else
+            RecordDrawCommand(_draw_commands, cmd, index_start, vertex_start, Vector2::ZERO, size);
+    }
+}
+
+void NuklearUI::RecordDrawCommand(PODVector<NuklearDrawCommand>& commands, const struct nk_draw_command* cmd,
+                                  unsigned index_start, unsigned vertex_start, const Vector2& origin,
+                                  const IntVector2& size)
+{
+    IntRect scissor(int((cmd->clip_rect.x - origin.x_) * _uiScale), int((cmd->clip_rect.y - origin.y_) * _uiScale),
+                    int((cmd->clip_rect.x + cmd->clip_rect.w - origin.x_) * _uiScale),
+                    int((cmd->clip_rect.y + cmd->clip_rect.h - origin.y_) * _uiScale));
+    scissor.left_ = Max(scissor.left_, 0);
+    scissor.top_ = Max(scissor.top_, 0);
+    scissor.right_ = Min(scissor.right_, size.x_);
+    scissor.bottom_ = Min(scissor.bottom_, size.y_);
+    if (scissor.left_ >= scissor.right_ || scissor.top_ >= scissor.bottom_)
+    {
+        _stats.culled_commands++;
+        return;
+    }
+
+    Texture2D* texture = static_cast<Texture2D*>(cmd->texture.ptr);
+    if (!commands.Empty())
+    {
+        NuklearDrawCommand& last = commands.Back();
+        if (last.texture == texture && last.scissor == scissor && last.vertex_start == vertex_start &&
+            last.index_start + last.index_count == index_start)
         {
-            // If texture contains only an alpha channel, use alpha shader (for fonts)
-            vs = _graphics->GetShader(VS, "Basic", "DIFFMAP VERTEXCOLOR");
-            if (texture->GetFormat() == Graphics::GetAlphaFormat())
-                ps = _graphics->GetShader(PS, "Basic", "ALPHAMAP VERTEXCOLOR");
-            else
-                ps = _graphics->GetShader(PS, "Basic", "DIFFMAP VERTEXCOLOR");
+            last.index_count += cmd->elem_count;
+            return;
         }
+    }
 
-        _graphics->SetShaders(vs, ps);
-        if (_graphics->NeedParameterUpdate(SP_OBJECT, this))
-            _graphics->SetShaderParameter(VSP_MODEL, Matrix3x4::IDENTITY);
-        if (_graphics->NeedParameterUpdate(SP_CAMERA, this))
-            _graphics->SetShaderParameter(VSP_VIEWPROJ, _projection);
-        if (_graphics->NeedParameterUpdate(SP_MATERIAL, this))
-            _graphics->SetShaderParameter(PSP_MATDIFFCOLOR, Color(1.0f, 1.0f, 1.0f, 1.0f));
+    NuklearDrawCommand draw;
+    draw.texture = texture;
+    draw.scissor = scissor;
+    draw.index_start = index_start;
+    draw.index_count = cmd->elem_count;
+    draw.vertex_start = vertex_start;
+    // Textures of cached windows are premultiplied wherever they are drawn, also when user draws them as images.
+    draw.premultiplied = false;
+    for (auto it = _window_caches.Begin(); texture && it != _window_caches.End() && !draw.premultiplied; ++it)
+        draw.premultiplied = it->second_.texture == texture;
+    commands.Push(draw);
+}
+
+bool NuklearUI::UpdateFrameFingerprint()
+{
+    if (!_frame_cache_enabled)
+        return false;
 
-        float elapsedTime = GetSubsystem<Time>()->GetElapsedTime();
-        _graphics->SetShaderParameter(VSP_ELAPSEDTIME, elapsedTime);
-        _graphics->SetShaderParameter(PSP_ELAPSEDTIME, elapsedTime);
+    ATOMIC_PROFILE(NuklearFrameFingerprint);
+    // Links between window command buffers are written when commands are built for the first time. Building them here
+    // makes command stream include window order. nk_convert() will not build them again.
+    nk__begin(&_nk);
 
-        IntRect scissor = IntRect(int(cmd->clip_rect.x * _uiScale), int(cmd->clip_rect.y * _uiScale),
-                                  int((cmd->clip_rect.x + cmd->clip_rect.w) * _uiScale),
-                                  int((cmd->clip_rect.y + cmd->clip_rect.h) * _uiScale));
+    // Commands occupy front of the buffer and `allocated` counts only them. Back of it holds window state when pool is
+    // not used.
+    const struct nk_buffer& memory = _nk.memory;
+    unsigned size = (unsigned)memory.allocated;
+    const unsigned char* commands = static_cast<const unsigned char*>(memory.memory.ptr);
 
-        _graphics->SetBlendMode(BLEND_ALPHA);
-        _graphics->SetScissorTest(true, scissor);
-        _graphics->SetTexture(0, texture);
-        _graphics->Draw(TRIANGLE_LIST, index, cmd->elem_count, 0, 0, _vertex_buffer->GetVertexCount());
-        index += cmd->elem_count;
+    if (size == _frame_fingerprint.Size() && (!size || memcmp(&_frame_fingerprint.Front(), commands, size) == 0))
+        return true;
+
+    _frame_fingerprint.Resize(size);
+    if (size)
+        memcpy(&_frame_fingerprint.Front(), commands, size);
+    return false;
+}
+
+void NuklearUI::UpdateMemoryStats()
+{
+    // Failed allocations of fixed buffers are still accounted in `needed`, which includes window state in back of the
+    // buffer as well.
+    const struct nk_buffer& memory = _nk.memory;
+    nk_size used = memory.allocated + (memory.memory.size - memory.size);
+    _stats.frame_memory_used = (unsigned)used;
+    _stats.frame_memory_peak = Max(_stats.frame_memory_peak, (unsigned)memory.needed);
+    if (memory.needed > used)
+        _stats.frame_memory_overflows++;
+    _stats.atlas_memory_used = _atlas_arena.used;
+    _stats.atlas_memory_overflows = _atlas_arena.overflows;
+}
+
+void NuklearUI::SetFrameCacheEnabled(bool enabled)
+{
+    _frame_cache_enabled = enabled;
+    _frame_fingerprint.Clear();
+}
+
+void NuklearUI::TrimBuffers(unsigned used_vertices, unsigned used_indices)
+{
+    if (!_buffer_shrink_delay)
+        return;
+
+    // Buffers are considered oversized when they are at least 4x larger than needed. Usage peak is tracked while they
+    // stay oversized so that shrinking leaves enough room for the largest frame seen recently.
+    unsigned vertex_capacity = _backend->GetVertexCapacity();
+    unsigned index_capacity = _backend->GetIndexCapacity();
+    bool vertices_oversized = vertex_capacity > _buffer_high_water_vertices && vertex_capacity / 4 > used_vertices;
+    bool indices_oversized = index_capacity > _buffer_high_water_indices && index_capacity / 4 > used_indices;
+    if (!vertices_oversized && !indices_oversized)
+    {
+        _buffer_oversized_frames = 0;
+        _buffer_peak_vertices = 0;
+        _buffer_peak_indices = 0;
+        return;
     }
 
-    // FIXME: Last frame was rendered incomplete or contained artifacts. We allocate more memory hoping to fit all the
-    // needed data on the next frame. Reallocation and nk_convert() should be retried as much as needed, however doing
-    // so commands overrun.
-    if (result & NK_CONVERT_VERTEX_BUFFER_FULL)
-        ReallocateBuffers((unsigned int)((vbuf.needed / _vertex_buffer->GetVertexSize()) * 2), 0);
-    if (result & NK_CONVERT_ELEMENT_BUFFER_FULL)
-        ReallocateBuffers(0, (unsigned int)((ebuf.needed / _index_buffer->GetIndexSize()) * 2));
+    _buffer_peak_vertices = Max(_buffer_peak_vertices, used_vertices);
+    _buffer_peak_indices = Max(_buffer_peak_indices, used_indices);
+    if (++_buffer_oversized_frames < _buffer_shrink_delay)
+        return;
 
-    nk_clear(&_nk);
-    _graphics->SetScissorTest(false);
+    unsigned vertex_count = 0;
+    unsigned index_count = 0;
+    if (vertices_oversized)
+        vertex_count = Max(_buffer_high_water_vertices, _buffer_peak_vertices * 2);
+    if (indices_oversized)
+        index_count = Max(_buffer_high_water_indices, _buffer_peak_indices * 2);
+    ReallocateBuffers(vertex_count, index_count);
+
+    _buffer_oversized_frames = 0;
+    _buffer_peak_vertices = 0;
+    _buffer_peak_indices = 0;
 }
 
 void NuklearUI::UpdateProjectionMatrix()
 {
-    IntVector2 viewSize = _graphics->GetViewport().Size();
-    Vector2 invScreenSize(1.0f / viewSize.x_, 1.0f / viewSize.y_);
+    _projection = MakeProjection(Vector2::ZERO, _backend->GetSize(), false);
+
+    // Recorded scissors depend on viewport size and ui scale.
+    _frame_cache_valid = false;
+}
+
+Matrix4 NuklearUI::MakeProjection(const Vector2& origin, const IntVector2& size, bool texture) const
+{
+    Vector2 invScreenSize(1.0f / size.x_, 1.0f / size.y_);
     Vector2 scale(2.0f * invScreenSize.x_, -2.0f * invScreenSize.y_);
     Vector2 offset(-1.0f, 1.0f);
+#ifdef ATOMIC_OPENGL
+    // OpenGL textures start at the bottom, render targets are flipped to be sampled same way as on Direct3D.
+    if (texture)
+    {
+        scale.y_ = -scale.y_;
+        offset.y_ = -offset.y_;
+    }
+#else
+    (void)texture;
+#endif
 
-    _projection = Matrix4(Matrix4::IDENTITY);
-    _projection.m00_ = scale.x_ * _uiScale;
-    _projection.m03_ = offset.x_;
-    _projection.m11_ = scale.y_ * _uiScale;
-    _projection.m13_ = offset.y_;
-    _projection.m22_ = 1.0f;
-    _projection.m23_ = 0.0f;
-    _projection.m33_ = 1.0f;
+    Matrix4 projection(Matrix4::IDENTITY);
+    projection.m00_ = scale.x_ * _uiScale;
+    projection.m03_ = offset.x_ - origin.x_ * projection.m00_;
+    projection.m11_ = scale.y_ * _uiScale;
+    projection.m13_ = offset.y_ - origin.y_ * projection.m11_;
+    projection.m22_ = 1.0f;
+    projection.m23_ = 0.0f;
+    projection.m33_ = 1.0f;
+#if NKUI_HALF_PIXEL_OFFSET && !NKUI_GENERIC_VERTEX_OUTPUT
+    // Half pixel offset is applied in ui units before scaling, same as offsetting every vertex.
+    projection.m03_ += 0.5f * projection.m00_;
+    projection.m13_ += 0.5f * projection.m11_;
+#endif
+    return projection;
 }
 
-void NuklearUI::AddDefaultFont(float default_font_size)
+void NuklearUI::SetWindowCached(const String& name, bool cached, bool composite)
 {
-    nk_font_atlas_begin(&_atlas);
-    if (default_font_size > 0)
+    nk_hash hash = nk_murmur_hash(name.CString(), (int)name.Length(), NK_WINDOW_TITLE);
+    _frame_cache_valid = false;
+    if (!cached)
     {
-        _atlas.default_font = nk_font_atlas_add_default(&_atlas, default_font_size, 0);
+        _window_caches.Erase(hash);
+        return;
+    }
+
+    NuklearWindowCache& cache = _window_caches[hash];
+    if (!cache.texture)
+        cache.texture = context_->CreateObject<Texture2D>();
+    cache.composite = composite;
+    // Force redraw.
+    cache.hash = 0;
+}
+
+Texture2D* NuklearUI::GetWindowTexture(const String& name) const
+{
+    auto it = _window_caches.Find(nk_murmur_hash(name.CString(), (int)name.Length(), NK_WINDOW_TITLE));
+    return it != _window_caches.End() ? it->second_.texture.Get() : 0;
+}
+
+void NuklearUI::BeginAddFonts()
+{
+    if (_font_batch_depth++ == 0)
+        nk_font_atlas_begin(&_atlas);
+}
+
+void NuklearUI::EndAddFonts()
+{
+    assert(_font_batch_depth > 0);
+    if (--_font_batch_depth == 0 && _atlas.font_num > 0)
         ReallocateFontTexture();
+}
+
+void NuklearUI::SetAlphaFontAtlas(bool enable)
+{
+    if (_alpha_font_atlas == enable)
+        return;
+    _alpha_font_atlas = enable;
+
+    // Rebake existing fonts unless that will happen at the end of current batch anyway.
+    if (_font_batch_depth == 0 && _atlas.font_num > 0)
+    {
+        BeginAddFonts();
+        EndAddFonts();
     }
 }
 
+void NuklearUI::AddDefaultFont(float default_font_size)
+{
+    BeginAddFonts();
+    if (default_font_size > 0)
+        _atlas.default_font = nk_font_atlas_add_default(&_atlas, default_font_size, 0);
+    EndAddFonts();
+}
+
 nk_font* NuklearUI::AddFont(const Atomic::String& font_path, float size, const nk_rune* ranges, NKUI_FontFlags flags)
 {
     if (size == 0)
@@ -429,6 +2520,8 @@ nk_font* NuklearUI::AddFont(const Atomic::String& font_path, float size, const n
 
     if (auto font_file = GetSubsystem<ResourceCache>()->GetFile(font_path))
     {
+        // Atlas keeps a copy of font data, it is baked when outermost batch ends.
+        BeginAddFonts();
         PODVector<uint8_t> data;
         data.Resize(font_file->GetSize());
         auto bytes_len = font_file->Read(&data.Front(), data.Size());
@@ -439,13 +2532,13 @@ nk_font* NuklearUI::AddFont(const Atomic::String& font_path, float size, const n
         if (flags & NKUI_FONT_MERGE)
         {
             config.merge_mode = 1;                 // always merges with last added font
-            config.font = &_atlas.fonts->info;     // baked font required, otherwise this will fail.
+            config.font = &_atlas.fonts->info;     // glyphs are baked into last added font
             config.coord_type = NK_COORD_PIXEL;
         }
         auto result = nk_font_atlas_add_from_memory(&_atlas, &data.Front(), bytes_len, size, &config);
         if (flags & NKUI_FONT_SET_DEFAULT)
             _atlas.default_font = result;
-        ReallocateFontTexture();
+        EndAddFonts();
         return result;
     }
     return 0;
@@ -457,33 +2550,465 @@ nk_font* NuklearUI::AddFont(const Atomic::String& font_path, float size, const s
     return AddFont(font_path, size, ranges.size() ? &*ranges.begin() : 0, flags);
 }
 
+nk_user_font* NuklearUI::AddDynamicFont(const Atomic::String& font_path, float size, int texture_size)
+{
+    auto font_file = GetSubsystem<ResourceCache>()->GetFile(font_path);
+    if (!font_file || size <= 0)
+        return 0;
+
+    PODVector<unsigned char> data(font_file->GetSize());
+    if (data.Empty() || font_file->Read(&data.Front(), data.Size()) != data.Size())
+        return 0;
+
+    SharedPtr<NuklearDynamicFont> font(new NuklearDynamicFont(context_, data, size, texture_size));
+    if (!font->IsValid())
+    {
+        ATOMIC_LOGERROR("NuklearUI: failed to load dynamic font " + font_path);
+        return 0;
+    }
+    _dynamic_fonts.Push(font);
+    return font->GetUserFont();
+}
+
 void NuklearUI::ReallocateFontTexture()
 {
-    int w, h;
-    const void* image = nk_font_atlas_bake(&_atlas, &w, &h, NK_FONT_ATLAS_RGBA32);
+    int w = 0, h = 0;
+    const void* image = 0;
+    PODVector<unsigned char> cached_image;
+    String cache_path;
+    if (!_font_cache_dir.Empty())
+    {
+        cache_path = _font_cache_dir + ToString("%016llX.nkatlas", GetFontAtlasKey());
+        if (LoadFontAtlasCache(cache_path, w, h, cached_image))
+            image = &cached_image.Front();
+    }
+
+    if (!image)
+    {
+        image = nk_font_atlas_bake(&_atlas, &w, &h, _alpha_font_atlas ? NK_FONT_ATLAS_ALPHA8 : NK_FONT_ATLAS_RGBA32);
+        if (!cache_path.Empty())
+            SaveFontAtlasCache(cache_path, w, h, image);
+    }
+
+    PODVector<unsigned char> composed;
+    if (!_alpha_font_atlas && !_images.Empty())
+    {
+        // Images are packed below glyphs. Glyph coordinates are normalized to baked size and have to be rescaled.
+        composed.Resize((unsigned)(w * h * 4));
+        memcpy(&composed.Front(), image, composed.Size());
+        int font_w = w, font_h = h;
+        PackImages(w, h, composed);
+        float scale_u = (float)font_w / w;
+        float scale_v = (float)font_h / h;
+        for (int i = 0; i < _atlas.glyph_count; i++)
+        {
+            _atlas.glyphs[i].u0 *= scale_u;
+            _atlas.glyphs[i].u1 *= scale_u;
+            _atlas.glyphs[i].v0 *= scale_v;
+            _atlas.glyphs[i].v1 *= scale_v;
+        }
+        // Cursor regions are in pixels and stay in place, but are relative to page size.
+        for (struct nk_cursor& cursor : _atlas.cursors)
+        {
+            cursor.img.w = (unsigned short)w;
+            cursor.img.h = (unsigned short)h;
+        }
+        _atlas.tex_width = w;
+        _atlas.tex_height = h;
+        image = &composed.Front();
+    }
+
+    // Alpha atlas is drawn with ALPHAMAP shader. Its white pixel has full alpha, so untextured geometry is not affected,
+    // while images keep using their own RGBA textures.
+    unsigned format = _alpha_font_atlas ? Graphics::GetAlphaFormat() : Graphics::GetRGBAFormat();
+    if (!_font_texture || _font_texture->GetWidth() != w || _font_texture->GetHeight() != h ||
+        _font_texture->GetFormat() != format)
+    {
+        _font_texture = context_->CreateObject<Texture2D>();
+        _font_texture->SetNumLevels(1);
+        _font_texture->SetSize(w, h, format);
+    }
+    if (_graphics)
+        _font_texture->SetData(0, 0, 0, w, h, image);
 
-    _font_texture = context_->CreateObject<Texture2D>();
-    _font_texture->SetNumLevels(1);
-    _font_texture->SetSize(w, h, Graphics::GetRGBAFormat());
-    _font_texture->SetData(0, 0, 0, w, h, image);
+    if (_alpha_font_atlas)
+        UpdateImageTexture();
+    else
+    {
+        _image_texture.Reset();
+        UpdateImageHandles(_font_texture);
+    }
 
     nk_font_atlas_end(&_atlas, nk_handle_ptr(_font_texture.Get()), &_draw_null_texture);
+    _stats.atlas_width = (unsigned)w;
+    _stats.atlas_height = (unsigned)h;
+    // Untextured geometry samples white pixel of the atlas so that it batches together with text.
+    _config.null = _draw_null_texture;
+    // Glyph coordinates changed.
+    InvalidateRetainedGeometry();
     if (_atlas.default_font)
         nk_style_set_font(&_nk, &_atlas.default_font->handle);
 }
 
+const struct nk_image* NuklearUI::AddImage(const String& resource_name)
+{
+    auto it = _images.Find(resource_name);
+    if (it != _images.End())
+        return &it->second_.handle;
+
+    SharedPtr<Image> image(GetSubsystem<ResourceCache>()->GetResource<Image>(resource_name));
+    if (image && image->IsCompressed())
+        image = image->GetDecompressedImage();
+    if (image && image->GetComponents() != 4)
+        image = image->ConvertToRGBA();
+    if (!image)
+    {
+        ATOMIC_LOGERROR("NuklearUI: failed to load image " + resource_name);
+        return 0;
+    }
+
+    NuklearAtlasImage& entry = _images[resource_name];
+    entry.image = image;
+    entry.handle = nk_image_ptr(0);
+    // Atlas is rebuilt at the end of current font batch otherwise.
+    if (_font_batch_depth == 0)
+    {
+        if (_atlas.font_num > 0)
+        {
+            BeginAddFonts();
+            EndAddFonts();
+        }
+        else
+            UpdateImageTexture();
+    }
+    return &entry.handle;
+}
+
+const struct nk_image* NuklearUI::GetImage(const String& resource_name) const
+{
+    auto it = _images.Find(resource_name);
+    return it != _images.End() ? &it->second_.handle : 0;
+}
+
+void NuklearUI::PackImages(int& width, int& height, PODVector<unsigned char>& pixels)
+{
+    // Transparent border keeps filtering from bleeding neighbours into images.
+    static const int PADDING = 1;
+    static const int MIN_PAGE_WIDTH = 512;
+    // Texture size supported by desktop and most mobile hardware.
+    static const int MAX_PAGE_SIZE = 4096;
+
+    // Images are placed on shelves, tallest first.
+    PODVector<NuklearAtlasImage*> order;
+    int page_width = width ? width : MIN_PAGE_WIDTH;
+    for (auto& it : _images)
+    {
+        it.second_.rect = IntRect::ZERO;
+        if (it.second_.image->GetWidth() + 2 * PADDING > MAX_PAGE_SIZE)
+        {
+            ATOMIC_LOGERROR("NuklearUI: image " + it.first_ + " is too large for atlas.");
+            continue;
+        }
+        order.Push(&it.second_);
+        page_width = Max(page_width, it.second_.image->GetWidth() + 2 * PADDING);
+    }
+    Sort(order.Begin(), order.End(), [](NuklearAtlasImage* a, NuklearAtlasImage* b) {
+        return a->image->GetHeight() > b->image->GetHeight();
+    });
+
+    int x = PADDING;
+    int y = height + PADDING;
+    int shelf_height = 0;
+    for (unsigned i = 0; i < order.Size();)
+    {
+        NuklearAtlasImage* entry = order[i];
+        int image_w = entry->image->GetWidth();
+        int image_h = entry->image->GetHeight();
+        int shelf_x = x;
+        int shelf_y = y;
+        if (shelf_x + image_w + PADDING > page_width)
+        {
+            shelf_x = PADDING;
+            shelf_y += shelf_height + PADDING;
+        }
+        if (shelf_y + image_h + PADDING > MAX_PAGE_SIZE)
+        {
+            ATOMIC_LOGERROR("NuklearUI: atlas is full, image " + String(image_w) + "x" + String(image_h) +
+                            " is left out.");
+            order.Erase(i);
+            continue;
+        }
+        if (shelf_y != y)
+            shelf_height = 0;
+        x = shelf_x;
+        y = shelf_y;
+        entry->rect = IntRect(x, y, x + image_w, y + image_h);
+        x += image_w + PADDING;
+        shelf_height = Max(shelf_height, image_h);
+        i++;
+    }
+    int page_height = y + shelf_height + PADDING;
+
+    PODVector<unsigned char> page((unsigned)(page_width * page_height * 4));
+    memset(&page.Front(), 0, page.Size());
+    for (int row = 0; row < height; row++)
+        memcpy(&page[row * page_width * 4], &pixels[row * width * 4], (size_t)width * 4);
+    for (NuklearAtlasImage* entry : order)
+    {
+        const unsigned char* data = entry->image->GetData();
+        int image_w = entry->rect.Width();
+        for (int row = 0; row < entry->rect.Height(); row++)
+        {
+            memcpy(&page[((entry->rect.top_ + row) * page_width + entry->rect.left_) * 4], data + row * image_w * 4,
+                   (size_t)image_w * 4);
+        }
+    }
+
+    pixels.Swap(page);
+    width = page_width;
+    height = page_height;
+}
+
+void NuklearUI::UpdateImageHandles(Texture2D* texture)
+{
+    for (auto& it : _images)
+    {
+        NuklearAtlasImage& entry = it.second_;
+        struct nk_rect region = nk_rect((float)entry.rect.left_, (float)entry.rect.top_, (float)entry.rect.Width(),
+                                        (float)entry.rect.Height());
+        entry.handle = nk_subimage_ptr(texture, (unsigned short)texture->GetWidth(),
+                                       (unsigned short)texture->GetHeight(), region);
+    }
+    // Handles of retained geometry point to old image locations.
+    InvalidateRetainedGeometry();
+}
+
+void NuklearUI::UpdateImageTexture()
+{
+    if (_images.Empty())
+        return;
+
+    int w = 0, h = 0;
+    PODVector<unsigned char> pixels;
+    PackImages(w, h, pixels);
+    _image_texture = context_->CreateObject<Texture2D>();
+    _image_texture->SetNumLevels(1);
+    _image_texture->SetSize(w, h, Graphics::GetRGBAFormat());
+    if (_graphics)
+        _image_texture->SetData(0, 0, 0, w, h, &pixels.Front());
+    UpdateImageHandles(_image_texture);
+}
+
+void NuklearUI::SetFontCacheDir(const String& dir)
+{
+    _font_cache_dir = dir.Empty() ? dir : AddTrailingSlash(dir);
+    if (!_font_cache_dir.Empty())
+        GetSubsystem<FileSystem>()->CreateDir(_font_cache_dir);
+}
+
+unsigned long long NuklearUI::GetFontAtlasKey() const
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hash = HashValue(hash, FONT_CACHE_VERSION);
+    hash = HashValue(hash, _alpha_font_atlas);
+    for (const struct nk_font_config* config = _atlas.config; config; config = config->next)
+    {
+        // Fonts merged into this one are linked in a circular list.
+        const struct nk_font_config* merged = config;
+        do
+        {
+            hash = HashBytes(hash, merged->ttf_blob, (unsigned)merged->ttf_size);
+            hash = HashValue(hash, merged->size);
+            hash = HashValue(hash, merged->merge_mode);
+            hash = HashValue(hash, merged->pixel_snap);
+            hash = HashValue(hash, merged->oversample_v);
+            hash = HashValue(hash, merged->oversample_h);
+            hash = HashValue(hash, merged->coord_type);
+            hash = HashValue(hash, merged->spacing);
+            hash = HashValue(hash, merged->fallback_glyph);
+            for (const nk_rune* range = merged->range; range && range[0]; range += 2)
+            {
+                hash = HashValue(hash, range[0]);
+                hash = HashValue(hash, range[1]);
+            }
+            merged = merged->n;
+        } while (merged && merged != config);
+    }
+    return hash;
+}
+
+unsigned NuklearUI::GetAtlasFontCount() const
+{
+    // font_num counts configs, including those merged into other fonts, which do not get a font of their own.
+    unsigned count = 0;
+    for (const struct nk_font* font = _atlas.fonts; font; font = font->next)
+        count++;
+    return count;
+}
+
+bool NuklearUI::LoadFontAtlasCache(const String& path, int& width, int& height, PODVector<unsigned char>& image)
+{
+    if (!GetSubsystem<FileSystem>()->FileExists(path))
+        return false;
+
+    ATOMIC_PROFILE(NuklearLoadFontAtlasCache);
+    File file(context_, path, FILE_READ);
+    if (!file.IsOpen())
+        return false;
+
+    // Whole file is read at once and validated before atlas is touched.
+    PODVector<unsigned char> data(file.GetSize());
+    if (data.Empty() || file.Read(&data.Front(), data.Size()) != data.Size())
+        return false;
+    MemoryBuffer buffer(data);
+
+    if (buffer.ReadUInt() != FONT_CACHE_MAGIC || buffer.ReadUInt() != FONT_CACHE_VERSION ||
+        buffer.ReadUInt() != sizeof(struct nk_font_glyph) || buffer.ReadBool() != _alpha_font_atlas)
+        return false;
+
+    width = buffer.ReadInt();
+    height = buffer.ReadInt();
+    struct nk_recti custom;
+    custom.x = buffer.ReadShort();
+    custom.y = buffer.ReadShort();
+    custom.w = buffer.ReadShort();
+    custom.h = buffer.ReadShort();
+    unsigned glyph_count = buffer.ReadUInt();
+    unsigned font_count = buffer.ReadUInt();
+    if (font_count != GetAtlasFontCount())
+        return false;
+
+    unsigned glyphs_size = glyph_count * sizeof(struct nk_font_glyph);
+    unsigned fonts_size = font_count * (3 * sizeof(float) + 2 * sizeof(unsigned));
+    unsigned cursors_size = NK_CURSOR_COUNT * (4 * sizeof(unsigned short) + 4 * sizeof(float));
+    unsigned image_size = width * height * (_alpha_font_atlas ? 1 : 4);
+    if (width <= 0 || height <= 0 ||
+        buffer.GetSize() - buffer.GetPosition() != glyphs_size + fonts_size + cursors_size + image_size)
+        return false;
+
+    if (_atlas.glyphs)
+        _atlas.permanent.free(_atlas.permanent.userdata, _atlas.glyphs);
+    _atlas.glyphs = static_cast<struct nk_font_glyph*>(_atlas.permanent.alloc(_atlas.permanent.userdata, 0, glyphs_size));
+    _atlas.glyph_count = glyph_count;
+    buffer.Read(_atlas.glyphs, glyphs_size);
+
+    for (struct nk_font* font = _atlas.fonts; font; font = font->next)
+    {
+        struct nk_baked_font baked;
+        baked.height = buffer.ReadFloat();
+        baked.ascent = buffer.ReadFloat();
+        baked.descent = buffer.ReadFloat();
+        baked.glyph_offset = buffer.ReadUInt();
+        baked.glyph_count = buffer.ReadUInt();
+        baked.ranges = font->config->range;
+        nk_font_init(font, font->config->size, font->config->fallback_glyph, _atlas.glyphs, &baked, nk_handle_ptr(0));
+    }
+
+    // Baking places cursors into custom region, texture handle is set by nk_font_atlas_end().
+    for (struct nk_cursor& cursor : _atlas.cursors)
+    {
+        cursor.img.w = (unsigned short)width;
+        cursor.img.h = (unsigned short)height;
+        for (unsigned short& region : cursor.img.region)
+            region = buffer.ReadUShort();
+        cursor.size.x = buffer.ReadFloat();
+        cursor.size.y = buffer.ReadFloat();
+        cursor.offset.x = buffer.ReadFloat();
+        cursor.offset.y = buffer.ReadFloat();
+    }
+
+    image.Resize(image_size);
+    buffer.Read(&image.Front(), image_size);
+
+    // nk_font_atlas_end() computes white pixel coordinates from these.
+    _atlas.tex_width = width;
+    _atlas.tex_height = height;
+    _atlas.custom = custom;
+    return true;
+}
+
+void NuklearUI::SaveFontAtlasCache(const String& path, int width, int height, const void* image)
+{
+    if (!image)
+        return;
+
+    File file(context_, path, FILE_WRITE);
+    if (!file.IsOpen())
+    {
+        ATOMIC_LOGWARNING("NuklearUI: can not write font atlas cache " + path);
+        return;
+    }
+
+    file.WriteUInt(FONT_CACHE_MAGIC);
+    file.WriteUInt(FONT_CACHE_VERSION);
+    file.WriteUInt(sizeof(struct nk_font_glyph));
+    file.WriteBool(_alpha_font_atlas);
+    file.WriteInt(width);
+    file.WriteInt(height);
+    file.WriteShort(_atlas.custom.x);
+    file.WriteShort(_atlas.custom.y);
+    file.WriteShort(_atlas.custom.w);
+    file.WriteShort(_atlas.custom.h);
+    file.WriteUInt((unsigned)_atlas.glyph_count);
+    file.WriteUInt(GetAtlasFontCount());
+    file.Write(_atlas.glyphs, _atlas.glyph_count * sizeof(struct nk_font_glyph));
+    for (struct nk_font* font = _atlas.fonts; font; font = font->next)
+    {
+        file.WriteFloat(font->info.height);
+        file.WriteFloat(font->info.ascent);
+        file.WriteFloat(font->info.descent);
+        file.WriteUInt(font->info.glyph_offset);
+        file.WriteUInt(font->info.glyph_count);
+    }
+    for (const struct nk_cursor& cursor : _atlas.cursors)
+    {
+        for (unsigned short region : cursor.img.region)
+            file.WriteUShort(region);
+        file.WriteFloat(cursor.size.x);
+        file.WriteFloat(cursor.size.y);
+        file.WriteFloat(cursor.offset.x);
+        file.WriteFloat(cursor.offset.y);
+    }
+    file.Write(image, width * height * (_alpha_font_atlas ? 1 : 4));
+}
+
 void NuklearUI::ReallocateBuffers(unsigned int vertex_count, unsigned int index_count)
 {
-    if (vertex_count)
+    unsigned old_vertex_capacity = _backend->GetVertexCapacity();
+    unsigned old_index_capacity = _backend->GetIndexCapacity();
+    _backend->ResizeBuffers(vertex_count, _vertex_elements, index_count);
+    _frame_cache_valid = false;
+    _stats.vertex_capacity = _backend->GetVertexCapacity();
+    _stats.index_capacity = _backend->GetIndexCapacity();
+    // Initial allocation of empty buffers is not a reallocation.
+    if ((old_vertex_capacity && _stats.vertex_capacity != old_vertex_capacity) ||
+        (old_index_capacity && _stats.index_capacity != old_index_capacity))
+        _stats.buffer_reallocations++;
+}
+
+void NuklearUI::SetBufferHighWaterMark(unsigned vertex_count, unsigned index_count)
+{
+    _buffer_high_water_vertices = vertex_count;
+    _buffer_high_water_indices = index_count;
+    ReallocateBuffers(vertex_count > _backend->GetVertexCapacity() ? vertex_count : 0,
+                      index_count > _backend->GetIndexCapacity() ? index_count : 0);
+}
+
+void NuklearUI::SetRenderBackend(NuklearRenderBackend* backend)
+{
+    if (!backend || backend == _backend)
+        return;
+
+    _backend = backend;
+    bool chunked = sizeof(nk_draw_index) == 2 && _backend->SupportsBaseVertex();
+    if (chunked != _vertex_chunks.enabled)
     {
-        PODVector<VertexElement> elems;
-        elems.Push(VertexElement(TYPE_VECTOR2, SEM_POSITION));
-        elems.Push(VertexElement(TYPE_VECTOR2, SEM_TEXCOORD));
-        elems.Push(VertexElement(TYPE_UBYTE4_NORM, SEM_COLOR));
-        _vertex_buffer->SetSize(vertex_count, elems, true);
+        _vertex_chunks.enabled = chunked;
+        InvalidateRetainedGeometry();
     }
-    if (index_count)
-        _index_buffer->SetSize(index_count, false, true);
+    ReallocateBuffers(Max(_buffer_high_water_vertices, _frame_vertex_count),
+                      Max(_buffer_high_water_indices, _frame_index_count));
+    UpdateProjectionMatrix();
 }
 
 void NuklearUI::SetScale(float scale)
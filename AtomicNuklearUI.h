@@ -25,10 +25,12 @@
 
 
 #include <Atomic/Core/Object.h>
-#include <Atomic/Graphics/VertexBuffer.h>
-#include <Atomic/Graphics/IndexBuffer.h>
+#include <Atomic/Core/WorkQueue.h>
 #include <Atomic/Graphics/Texture2D.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/Resource/Image.h>
 #include "nuklear/nuklear.h"
+#include "AtomicNuklearBackend.h"
 
 #define NK_POINTER_HASH(p) (((int32_t)((size_t)p & 0xFFFFFFFF)) ^ (int32_t)((size_t)p >> 32))
 
@@ -36,6 +38,11 @@ namespace Atomic
 {
 
 ATOMIC_EVENT(E_NUKLEARFRAME, NuklearFrame) { }
+/// Sent after every rendered frame when enabled with NuklearUI::SetStatsEventEnabled().
+ATOMIC_EVENT(E_NUKLEARSTATS, NuklearStats)
+{
+    ATOMIC_PARAM(P_STATS, Stats);           // const NuklearUIStats pointer
+}
 
 enum NKUI_FontFlags
 {
@@ -44,12 +51,119 @@ enum NKUI_FontFlags
     NKUI_FONT_SET_DEFAULT = 2,
 };
 
+/// Memory configuration of NuklearUI. Heap is used for every budget that is 0.
+struct NuklearMemoryConfig
+{
+    /// Memory for nuklear context (commands and window state). Allocated internally when null.
+    void* frame_memory = 0;
+    /// Size of nuklear context memory in bytes.
+    unsigned frame_budget = 0;
+    /// Memory for nuklear draw commands. Allocated internally when null.
+    void* command_memory = 0;
+    /// Size of draw command memory in bytes.
+    unsigned command_budget = 0;
+    /// Memory for long-lived font atlas data. Allocated internally when null.
+    void* atlas_memory = 0;
+    /// Size of atlas arena in bytes. Allocations exceeding it fall back to heap. Arena holds fonts of every batch for
+    /// the lifetime of NuklearUI and glyphs of the latest bake only, glyphs of previous bake are released on rebake.
+    unsigned atlas_budget = 0;
+};
+
+/// Linear allocator for nuklear allocations that live as long as the arena. Only freeing the most recent allocation
+/// returns its memory, other frees are no-ops.
+struct NuklearArena
+{
+    /// Arena memory.
+    unsigned char* memory = 0;
+    /// Arena size in bytes.
+    unsigned size = 0;
+    /// Allocated bytes.
+    unsigned used = 0;
+    /// Offset of the most recent allocation that was not freed, or M_MAX_UNSIGNED.
+    unsigned last = Atomic::M_MAX_UNSIGNED;
+    /// Number of allocations that did not fit.
+    unsigned overflows = 0;
+};
+
+class NuklearSegmentTessellator;
+
+/// Range of nuklear commands drawn by a single window. Popups and overlay form a segment without a window.
+struct NuklearCommandSegment
+{
+    /// Window that produced commands, or null.
+    struct nk_window* window;
+    /// First command of the range.
+    const struct nk_command* first;
+    /// Last command of the range.
+    const struct nk_command* last;
+    /// Hash of commands and conversion settings. Computed only when window geometry or textures are reused.
+    unsigned long long hash;
+    /// Tessellator holding geometry of the segment, or null when segment is tessellated directly into draw list.
+    NuklearSegmentTessellator* tessellator;
+    /// Range contains custom commands. Their hash covers only callback pointers, so geometry is never reused.
+    bool custom;
+};
+
+/// Geometry of a draw list split into chunks of vertices that 16-bit indices can address. Every chunk is drawn with its
+/// first vertex as base vertex.
+struct NuklearVertexChunks
+{
+    /// Split geometry that does not fit into one chunk. Requires 16-bit indices and base vertex support of backend.
+    bool enabled = false;
+    /// Number of vertices in chunks preceding the current one. Draw list counts vertices of current chunk only.
+    unsigned base = 0;
+    /// First nuklear draw command of every chunk except the first one.
+    Atomic::PODVector<unsigned> commands;
+    /// First vertex of every chunk except the first one.
+    Atomic::PODVector<unsigned> vertices;
+};
+
+/// Window that is rendered into its own texture and redrawn only when it changes.
+struct NuklearWindowCache
+{
+    /// Texture window is rendered into.
+    Atomic::SharedPtr<Atomic::Texture2D> texture;
+    /// Draw texture on screen in place of window geometry.
+    bool composite = true;
+    /// Hash of window commands texture was rendered from.
+    unsigned long long hash = 0;
+    /// Window bounds in ui units.
+    struct nk_rect bounds;
+    /// Texture size in pixels. Tracked separately, because headless mode does not create textures.
+    Atomic::IntVector2 size = Atomic::IntVector2::ZERO;
+    /// Texture has to be redrawn this frame.
+    bool redraw = false;
+    /// First nuklear draw command produced by window.
+    unsigned command_start = 0;
+    /// One past last nuklear draw command produced by window.
+    unsigned command_end = 0;
+    /// Draw commands rendered into texture.
+    Atomic::PODVector<NuklearDrawCommand> commands;
+    /// Projection mapping window bounds to texture.
+    Atomic::Matrix4 projection;
+};
+
+/// Image registered with NuklearUI::AddImage() and packed into an atlas texture.
+struct NuklearAtlasImage
+{
+    /// RGBA pixels of the image.
+    Atomic::SharedPtr<Atomic::Image> image;
+    /// Position of the image in atlas texture, in pixels.
+    Atomic::IntRect rect;
+    /// Handle referencing atlas texture with sub-rectangle of the image.
+    struct nk_image handle;
+};
+
+class NuklearDynamicFont;
+
 class NuklearUI
     : public Atomic::Object
 {
 ATOMIC_OBJECT(NuklearUI, Atomic::Object);
 public:
     NuklearUI(Atomic::Context* context);
+    /// Construct with nuklear memory placed in fixed size arenas.
+    NuklearUI(Atomic::Context* context, const NuklearMemoryConfig& memory);
     virtual ~NuklearUI();
 
     /// Get nuklear context.
@@ -60,6 +174,19 @@ public:
     float GetScale() const { return _uiScale; }
     /// Set ui scale.
     void SetScale(float scale);
+    /// Begin adding fonts. Font atlas is baked and uploaded once when matching EndAddFonts() is called. Calls may nest.
+    void BeginAddFonts();
+    /// End adding fonts, bake and upload font atlas if this is the outermost batch.
+    void EndAddFonts();
+    /// Store font atlas in a single channel alpha texture instead of RGBA one, using 4x less memory.
+    void SetAlphaFontAtlas(bool enable);
+    /// Return true if font atlas is stored in a single channel alpha texture.
+    bool IsAlphaFontAtlas() const { return _alpha_font_atlas; }
+    /// Set directory where baked font atlases are cached. Atlas is loaded from cache instead of being rasterized when
+    /// font data, sizes, ranges and baking options match. Empty string disables caching.
+    void SetFontCacheDir(const Atomic::String& dir);
+    /// Get font atlas cache directory.
+    const Atomic::String& GetFontCacheDir() const { return _font_cache_dir; }
     /// Add default font which is embedded in nuklear library.
     void AddDefaultFont(float default_font_size = 13.f);
     //! Add font to imgui subsystem.
@@ -80,19 +207,269 @@ public:
       \return ImFont instance that may be used for setting current font when drawing GUI.
     */
     nk_font* AddFont(const Atomic::String& font_path, float size, const std::initializer_list<nk_rune>& ranges, NKUI_FontFlags flags=NKUI_FONT_NONE);
+    //! Add font whose glyphs are rasterized on first use.
+    /*!
+      Glyphs are packed into a single alpha texture of fixed size. Glyphs that were not drawn for the longest time are
+      evicted when texture is full, so memory stays bounded regardless of how many codepoints are used.
+      \param font_path a string pointing to TTF font resource.
+      \param size a font size.
+      \param texture_size width and height of glyph texture.
+      \return nuklear font handle that may be set with nk_style_set_font(), or null on failure.
+    */
+    nk_user_font* AddDynamicFont(const Atomic::String& font_path, float size, int texture_size = 1024);
+    //! Register an image and pack it into an atlas texture.
+    /*!
+      Images are packed below glyphs of font atlas, so that text, shapes and images share a texture and batch into
+      few draw calls. With alpha font atlas images get a separate RGBA texture. Atlas is rebuilt whenever images or
+      fonts are added, registering images between BeginAddFonts() and EndAddFonts() rebuilds it once.
+      \param resource_name name of image resource loaded through ResourceCache.
+      \return image handle that stays valid and is updated when atlas is rebuilt, or null if image can not be loaded.
+    */
+    const struct nk_image* AddImage(const Atomic::String& resource_name);
+    /// Return handle of a registered image, or null.
+    const struct nk_image* GetImage(const Atomic::String& resource_name) const;
+    /// Set minimal vertex and index buffer capacity. Buffers are allocated with at least this size and are never shrunk below it.
+    void SetBufferHighWaterMark(unsigned vertex_count, unsigned index_count);
+    /// Set number of consecutive frames buffers have to stay oversized before they are shrunk. 0 disables shrinking.
+    void SetBufferShrinkDelay(unsigned frames) { _buffer_shrink_delay = frames; }
+    /// Get number of consecutive frames buffers have to stay oversized before they are shrunk.
+    unsigned GetBufferShrinkDelay() const { return _buffer_shrink_delay; }
+    /// Enable reusing uploaded geometry when nuklear command stream did not change since previous frame. Frames
+    /// containing custom commands are always converted again, because data their callbacks draw may change.
+    void SetFrameCacheEnabled(bool enabled);
+    /// Return true if geometry of identical frames is reused.
+    bool IsFrameCacheEnabled() const { return _frame_cache_enabled; }
+    //! Render window into its own texture.
+    /*!
+      Texture is redrawn only when commands of the window change or it receives input. Otherwise window is not
+      tessellated at all and texture is drawn as a single textured quad. Windows containing custom commands are
+      redrawn every frame.
+      \param name name of the window, as passed to nk_begin() or nk_begin_titled().
+      \param cached enable or disable caching.
+      \param composite draw texture on screen in place of the window. When false window is only rendered into texture,
+             for example to be displayed on an in-world surface.
+    */
+    void SetWindowCached(const Atomic::String& name, bool cached, bool composite = true);
+    /// Get texture that cached window is rendered into, or null if window is not cached. Texture holds premultiplied
+    /// alpha and has to be blended with BLEND_PREMULALPHA.
+    Atomic::Texture2D* GetWindowTexture(const Atomic::String& name) const;
+    /// Get rendering statistics.
+    const NuklearUIStats& GetStats() const { return _stats; }
+    /// Send E_NUKLEARSTATS after every rendered frame.
+    void SetStatsEventEnabled(bool enabled) { _stats_event_enabled = enabled; }
+    /// Return true if E_NUKLEARSTATS is sent after every rendered frame.
+    bool IsStatsEventEnabled() const { return _stats_event_enabled; }
+    //! Coalesce raw input events received during a frame.
+    /*!
+      Mouse and touch motion is collapsed to latest position and wheel deltas are accumulated. Both are applied before
+      the next button event and at the end of input, so order of buttons, keys and text is preserved. Whether pointer
+      events are consumed is decided from window hover state, which is computed once per batch of motion events
+      instead of for every event.
+    */
+    void SetInputCoalescing(bool enable) { _input_coalescing = enable; }
+    /// Return true if raw input events are coalesced.
+    bool IsInputCoalescing() const { return _input_coalescing; }
+    //! Record input received by nuklear into a file.
+    /*!
+      Every key, button, motion, scroll and glyph passed to nuklear is written as a compact binary record, together
+      with frame boundaries, ui scale and viewport size of every frame. Recording can be replayed without SDL or a window.
+      \return false if file can not be opened.
+    */
+    bool StartInputRecording(const Atomic::String& path);
+    /// Stop recording input and close the file.
+    void StopInputRecording();
+    /// Return true if input is being recorded.
+    bool IsRecordingInput() const { return _input_record.NotNull(); }
+    //! Replay input recording.
+    /*!
+      Live input is ignored while replaying. One recorded frame is fed to nuklear before every E_NUKLEARFRAME, or
+      with ReplayInputFrame() when engine main loop does not run. Recorded ui scale is applied as well.
+      \param loop restart from the first frame at the end of recording instead of stopping.
+      \return false if file is not an input recording.
+    */
+    bool StartInputReplay(const Atomic::String& path, bool loop = false);
+    /// Stop replaying input and accept live input again.
+    void StopInputReplay();
+    /// Return true if input is being replayed.
+    bool IsReplayingInput() const { return _input_replay.NotNull(); }
+    /// Feed next recorded frame of input to nuklear. Returns false when replay is not active or it ended.
+    bool ReplayInputFrame();
+    /// Get viewport size of last replayed frame. Default headless backend is resized to it automatically.
+    const Atomic::IntVector2& GetReplayViewportSize() const { return _replay_viewport; }
+    /// Set backend that receives converted geometry. Graphics backend is used by default, null backend in headless mode.
+    void SetRenderBackend(NuklearRenderBackend* backend);
+    /// Get backend that receives converted geometry.
+    NuklearRenderBackend* GetRenderBackend() const { return _backend; }
+    //! Tessellate UI on a worker thread while engine renders the scene.
+    /*!
+      Conversion of commands built by E_NUKLEARFRAME handlers starts right after them on a WorkQueue thread, into
+      memory staging buffers. Geometry is uploaded and submitted at the end of rendering as usual, so no latency is
+      added. Layout, input and clipboard stay on the main thread. Frames containing custom commands are converted on
+      the main thread, because their callbacks are user code. Nuklear context must not be used outside of
+      E_NUKLEARFRAME handlers while this is enabled.
+    */
+    void SetPipelined(bool enable);
+    /// Return true if UI is tessellated on a worker thread.
+    bool IsPipelined() const { return _pipelined; }
+    /// Tessellate windows in parallel on WorkQueue threads, then join their geometry. Output is identical to serial
+    /// tessellation. Used when WorkQueue has worker threads and conversion is not pipelined.
+    void SetParallelTessellation(bool enable) { _parallel_tessellation = enable; }
+    /// Return true if windows are tessellated in parallel.
+    bool IsParallelTessellation() const { return _parallel_tessellation; }
+    /// Keep tessellated geometry of every window and tessellate only windows whose commands changed since previous
+    /// frame. Geometry of unchanged windows is copied into geometry buffers. Windows with custom commands are
+    /// tessellated every frame.
+    void SetRetainedGeometry(bool enable);
+    /// Return true if geometry of unchanged windows is reused.
+    bool IsRetainedGeometry() const { return _retained_geometry; }
+    /// Compute circle, arc and curve segment counts of every primitive from its size on screen, so that small shapes
+    /// get few triangles. Configured segment counts become upper limits.
+    void SetAdaptiveTessellation(bool enable);
+    /// Return true if segment counts are computed per primitive.
+    bool IsAdaptiveTessellation() const { return _adaptive_tessellation; }
+    //! Set per-frame cost budget of UI conversion.
+    /*!
+      When conversion exceeds the budget for a few frames, curve quality and then anti-aliasing are lowered a step.
+      Quality is raised back after UI stays well under budget for a longer time. Current level is reported in stats.
+      \param convert_time_us conversion time budget in microseconds, 0 for no limit.
+      \param vertex_count vertex count budget, 0 for no limit.
+    */
+    void SetTessellationBudget(unsigned convert_time_us, unsigned vertex_count);
+    //! Upload vertices in packed 12 byte format instead of 20 byte float format.
+    /*!
+      Positions are stored as 16-bit fixed point ui units, texture coordinates as normalized 16-bit values. Geometry
+      is converted into memory and packed while uploading. Requires NuklearPacked shaders from Data directory being
+      available to ResourceCache. Float format is used when viewport or font atlas exceed precision of packed format.
+    */
+    void SetPackedVertices(bool enable) { _packed_vertices = enable; }
+    /// Return true if packed vertex format is used when possible.
+    bool IsPackedVertices() const { return _packed_vertices; }
+    /// Convert and submit current frame. Called automatically at the end of rendering, or at the end of frame in
+    /// headless mode.
+    void Render();
 
 protected:
     void OnInputBegin();
     void OnRawEvent(Atomic::VariantMap& args);
     void OnInputEnd();
+    /// Apply mouse motion, deferred when input is coalesced.
+    void InputMotion(int x, int y);
+    /// Apply wheel scroll, accumulated when input is coalesced.
+    void InputScroll(float x, float y);
+    /// Apply coalesced motion and scroll.
+    void FlushInput();
+    /// Apply coalesced motion only.
+    void FlushMotion();
+    /// Pass key to nuklear and record it.
+    void InputKey(enum nk_keys key, int down);
+    /// Pass mouse button to nuklear and record it.
+    void InputButton(enum nk_buttons button, int x, int y, int down);
+    /// Pass text input to nuklear and record it.
+    void InputGlyph(const nk_glyph glyph);
+    /// Pass mouse position to nuklear and record it.
+    void ApplyMotion(int x, int y);
+    /// Pass scroll delta to nuklear and record it.
+    void ApplyScroll(struct nk_vec2 delta);
+    /// Return true if mouse hovers any window at the position nuklear will see, including coalesced motion that was
+    /// not applied yet. Result is reused until mouse position changes.
+    bool IsAnyWindowHovered();
     void OnEndRendering();
+    /// Reset per-frame timings of conversion stages.
+    void ResetFrameStats();
+    /// Convert frame unless it did not change since previous one. Returns false if frame can not be drawn.
+    bool ConvertFrame();
+    /// Convert nuklear commands into vertex and index buffers, growing them as needed. Returns false if geometry did not fit.
+    bool ConvertDrawLists();
+    //! Convert nuklear commands into memory.
+    /*!
+      \param vertices memory receiving vertices.
+      \param vertex_count vertex capacity of memory. Replaced with count to grow to if vertices did not fit.
+      \param indices memory receiving indices.
+      \param index_count index capacity of memory. Replaced with count to grow to if indices did not fit.
+      \return nk_convert() result flags.
+    */
+    nk_flags ConvertGeometry(void* vertices, unsigned& vertex_count, void* indices, unsigned& index_count);
+    /// Upload glyphs rasterized by dynamic fonts during conversion.
+    void UploadGlyphs();
+    /// Start converting current frame on a worker thread.
+    void BeginStagedConvert();
+    /// Wait for worker conversion and upload its geometry. Returns false if frame can not be drawn.
+    bool EndStagedConvert();
+    /// Convert nuklear commands into staging buffers, growing them as needed. Runs on worker thread.
+    bool ConvertStagedGeometry();
+    /// Pack registered images below image of given size. Pixels are RGBA and are replaced by the enlarged image.
+    /// Images that do not fit into largest atlas size are left out and get an empty rect.
+    void PackImages(int& width, int& height, Atomic::PODVector<unsigned char>& pixels);
+    /// Point handles of registered images to a texture they were packed into.
+    void UpdateImageHandles(Atomic::Texture2D* texture);
+    /// Pack registered images into their own texture.
+    void UpdateImageTexture();
+    /// Size staging buffers to match backend buffers if they were not used yet.
+    void ReserveStagedGeometry();
+    /// Copy staged geometry into backend buffers, packing vertices when packed format is active.
+    void UploadStagedGeometry();
+    /// Switch vertex format of backend buffers between packed and float format.
+    void UpdateVertexFormat();
+    /// Work item function of pipelined conversion.
+    static void StagedConvertWork(const Atomic::WorkItem* item, unsigned threadIndex);
+    /// Tessellate frame into staging memory and record draw commands. Worker is set when called on a WorkQueue thread.
+    void ConvertStaged(bool worker);
+    /// Shrink vertex and index buffers that stayed oversized for a long time.
+    void TrimBuffers(unsigned used_vertices, unsigned used_indices);
+    /// Split nuklear command stream into per-window segments.
+    void CollectCommandSegments();
+    /// Decide which cached windows have to be redrawn and resize their textures.
+    void UpdateWindowCaches();
+    /// Assign tessellators to segments and tessellate segments that can not reuse geometry, in parallel if allowed.
+    void PrepareSegments(bool allow_parallel);
+    /// Tessellate segments and convert them into geometry buffers, or staging buffers when staged is set. Segments
+    /// are not tessellated in parallel when worker is set, because it already runs on a WorkQueue thread. Returns
+    /// false if geometry did not fit.
+    bool TessellateAndConvert(bool staged, bool worker);
+    /// Return total number of glyphs evicted by dynamic fonts.
+    unsigned GetGlyphEvictions() const;
+    /// Drop geometry kept for windows.
+    void InvalidateRetainedGeometry();
+    /// Return pixels per ui unit used for computing segment counts, or 0 if they are fixed.
+    float GetAdaptiveScale() const { return _adaptive_tessellation ? _uiScale : 0.0f; }
+    /// Apply tessellation settings of governor quality level.
+    void SetQualityLevel(unsigned level);
+    /// Step quality level according to cost of last converted frame.
+    void UpdateQualityGovernor();
+    /// Tessellate command segments into draw list. Returns nk_convert() result flags.
+    nk_flags ConvertSegments(struct nk_buffer* vertices, struct nk_buffer* elements);
+    /// Record draw commands of converted draw list.
+    void RecordDrawCommands();
+    /// Record a single nuklear draw command, merging it with previous one when possible. Scissor is made relative to
+    /// origin given in ui units and clipped to target size.
+    void RecordDrawCommand(Atomic::PODVector<NuklearDrawCommand>& commands, const struct nk_draw_command* cmd,
+                           unsigned index_start, unsigned vertex_start, const Atomic::Vector2& origin,
+                           const Atomic::IntVector2& size);
+    /// Create projection mapping area starting at origin given in ui units to render target of specified size.
+    Atomic::Matrix4 MakeProjection(const Atomic::Vector2& origin, const Atomic::IntVector2& size, bool texture) const;
+    /// Send E_NUKLEARSTATS if enabled.
+    void SendStatsEvent();
+    /// Compare nuklear command stream with the one of previous frame and remember it. Returns true if they are identical.
+    bool UpdateFrameFingerprint();
 
     static void ClipboardCopy(nk_handle usr, const char* text, int len);
     static void ClipboardPaste(nk_handle usr, struct nk_text_edit* edit);
+    static void* ArenaAlloc(nk_handle arena, void* old, nk_size size);
+    static void ArenaFree(nk_handle arena, void* memory);
+    /// Update memory usage statistics of the frame.
+    void UpdateMemoryStats();
 
     void UpdateProjectionMatrix();
     void ReallocateBuffers(unsigned int vertex_count, unsigned int index_count);
     void ReallocateFontTexture();
+    /// Return hash of everything that affects baked font atlas.
+    unsigned long long GetFontAtlasKey() const;
+    /// Return number of fonts in atlas, not counting fonts merged into others.
+    unsigned GetAtlasFontCount() const;
+    /// Load baked atlas pixels, glyphs and font metrics from cache file. Returns false if cache can not be used.
+    bool LoadFontAtlasCache(const Atomic::String& path, int& width, int& height, Atomic::PODVector<unsigned char>& image);
+    /// Save atlas that was just baked to cache file.
+    void SaveFontAtlasCache(const Atomic::String& path, int width, int height, const void* image);
 
     nk_context _nk;
     struct nk_font_atlas _atlas;
@@ -102,11 +479,74 @@ protected:
 
     Atomic::WeakPtr<Atomic::Graphics> _graphics;
     Atomic::SharedPtr<Atomic::Texture2D> _null_texture;
-    Atomic::SharedPtr<Atomic::VertexBuffer> _vertex_buffer;
-    Atomic::SharedPtr<Atomic::IndexBuffer> _index_buffer;
+    Atomic::SharedPtr<NuklearRenderBackend> _backend;
+    /// Backend created when running without Graphics.
+    Atomic::WeakPtr<NuklearNullBackend> _headless_backend;
+    Atomic::PODVector<Atomic::VertexElement> _vertex_elements;
     Atomic::SharedPtr<Atomic::Texture2D> _font_texture;
+    Atomic::HashMap<Atomic::String, NuklearAtlasImage> _images;
+    Atomic::SharedPtr<Atomic::Texture2D> _image_texture;
     Atomic::Matrix4 _projection;
     float _uiScale = 1.0f;
+    unsigned _buffer_high_water_vertices = 1024;
+    unsigned _buffer_high_water_indices = 1024;
+    unsigned _buffer_shrink_delay = 300;
+    unsigned _buffer_oversized_frames = 0;
+    unsigned _buffer_peak_vertices = 0;
+    unsigned _buffer_peak_indices = 0;
+    Atomic::PODVector<NuklearDrawCommand> _draw_commands;
+    unsigned _frame_vertex_count = 0;
+    unsigned _frame_index_count = 0;
+    bool _frame_cache_enabled = false;
+    bool _frame_cache_valid = false;
+    Atomic::PODVector<unsigned char> _frame_fingerprint;
+    NuklearUIStats _stats;
+    bool _stats_event_enabled = false;
+    bool _input_coalescing = false;
+    bool _motion_pending = false;
+    int _motion_x = 0;
+    int _motion_y = 0;
+    struct nk_vec2 _scroll_pending = {0, 0};
+    bool _hover_valid = false;
+    bool _hovered = false;
+    Atomic::SharedPtr<Atomic::File> _input_record;
+    bool _recording_frame = false;
+    Atomic::SharedPtr<Atomic::File> _input_replay;
+    bool _replay_loop = false;
+    Atomic::IntVector2 _replay_viewport;
+    Atomic::PODVector<unsigned char> _frame_memory;
+    Atomic::PODVector<unsigned char> _command_memory;
+    Atomic::PODVector<unsigned char> _atlas_memory;
+    NuklearArena _atlas_arena;
+    unsigned _font_batch_depth = 0;
+    bool _alpha_font_atlas = false;
+    Atomic::String _font_cache_dir;
+    Atomic::Vector<Atomic::SharedPtr<NuklearDynamicFont>> _dynamic_fonts;
+    Atomic::PODVector<NuklearCommandSegment> _segments;
+    NuklearVertexChunks _vertex_chunks;
+    Atomic::HashMap<unsigned, NuklearWindowCache> _window_caches;
+    bool _parallel_tessellation = false;
+    Atomic::Vector<Atomic::SharedPtr<NuklearSegmentTessellator>> _tessellators;
+    bool _retained_geometry = false;
+    bool _packed_vertices = false;
+    bool _packed_active = false;
+    bool _adaptive_tessellation = false;
+    unsigned _budget_convert_time_us = 0;
+    unsigned _budget_vertices = 0;
+    unsigned _budget_over_frames = 0;
+    unsigned _budget_under_frames = 0;
+    unsigned _retained_frame = 0;
+    Atomic::HashMap<unsigned, Atomic::SharedPtr<NuklearSegmentTessellator>> _retained_segments;
+    bool _pipelined = false;
+    Atomic::SharedPtr<Atomic::WorkItem> _convert_item;
+    /// Staged conversion of current frame was started, on a worker or on main thread, and was not uploaded yet.
+    bool _staged_pending = false;
+    bool _staged_result = false;
+    /// Command stream of current frame contains custom commands.
+    bool _frame_has_custom = false;
+    Atomic::IntVector2 _staged_size;
+    Atomic::PODVector<unsigned char> _staged_vertices;
+    Atomic::PODVector<unsigned char> _staged_indices;
 };
 
 }
@@ -0,0 +1,305 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Rokas Kupstys
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "AtomicNuklearWidgets.h"
+
+namespace Atomic
+{
+
+/// Height of scroll range nuklear lays out at most. Float positions within it are precise to 1/8 of a pixel, taller
+/// lists are mapped into it.
+static const double MAX_CONTENT_HEIGHT = 1 << 20;
+/// Number of variable height rows measured per frame in addition to visible ones.
+static const unsigned MEASURE_ROWS_PER_FRAME = 1024;
+
+/// Map scroll position from range [0, from_max] to [0, to_max]. Both ends are mapped one to one over edge pixels, so
+/// that rows near the ends are placed exactly where they belong, the middle is scaled.
+static double MapScroll(double value, double from_max, double to_max, double edge)
+{
+    if (from_max <= 2 * edge || to_max <= 2 * edge)
+        return Min(value, to_max);
+    if (value <= edge)
+        return value;
+    if (value >= from_max - edge)
+        return value - from_max + to_max;
+    return edge + (value - edge) * (to_max - 2 * edge) / (from_max - 2 * edge);
+}
+
+/// Lay out an empty row of exact height. Item spacing is not added after it.
+static void AddSpacer(nk_context* ctx, float height)
+{
+    if (height <= 0)
+        return;
+    float spacing = ctx->style.window.spacing.y;
+    ctx->style.window.spacing.y = 0;
+    nk_layout_row_dynamic(ctx, height, 1);
+    ctx->style.window.spacing.y = spacing;
+    nk_spacing(ctx, 1);
+}
+
+NuklearVirtualList::NuklearVirtualList(float row_height)
+    : _row_height(row_height)
+{
+}
+
+void NuklearVirtualList::SetRowHeight(float height)
+{
+    _row_height = height;
+    _height_callback = nullptr;
+    InvalidateRowHeights();
+}
+
+void NuklearVirtualList::SetRowHeightCallback(const NuklearRowHeightCallback& callback)
+{
+    _height_callback = callback;
+    InvalidateRowHeights();
+}
+
+void NuklearVirtualList::InvalidateRowHeights(unsigned first)
+{
+    if (first < _row_heights.Size())
+    {
+        _row_heights.Resize(first);
+        _row_offsets.Resize(first + 1);
+    }
+}
+
+bool NuklearVirtualList::Draw(nk_context* ctx, const char* name, float height, unsigned row_count,
+                              const NuklearRowCallback& draw_row, nk_flags flags)
+{
+    return DrawRows(ctx, name, height, row_count, [&](unsigned row, float row_height) {
+        nk_layout_row_dynamic(ctx, row_height, 1);
+        draw_row(ctx, row);
+    }, flags);
+}
+
+bool NuklearVirtualList::DrawRows(nk_context* ctx, const char* name, float height, unsigned row_count,
+                                  const std::function<void(unsigned row, float row_height)>& draw_row, nk_flags flags)
+{
+    float spacing = ctx->style.window.spacing.y;
+    float fixed_height = GetFixedRowHeight(ctx);
+    float row_step = fixed_height + spacing;
+    if (_height_callback)
+        UpdateRowOffsets(row_count, spacing);
+    if (_anchor_row > row_count)
+    {
+        _anchor_row = row_count;
+        _anchor_offset = 0;
+    }
+
+    // Rows end one item spacing before total height, group padding is added by nuklear on both sides.
+    double padding = ctx->style.window.group_padding.y * 2;
+    double total = GetRowOffset(row_count, row_step);
+    double content = Min(total, MAX_CONTENT_HEIGHT);
+    double max_scroll = Max(total + padding - _view_height, 0.0);
+    double max_content_scroll = Max(content + padding - _view_height, 0.0);
+    double scroll = GetRowOffset(_anchor_row, row_step) + _anchor_offset;
+
+    // Scrollbar sets a position in scaled range, wheel and keys scroll by pixels.
+    if (_scroll_y != _scroll_y_set)
+    {
+        if (_scrollbar_dragged)
+            scroll = MapScroll(_scroll_y, max_content_scroll, max_scroll, _view_height);
+        else
+            scroll += (double)_scroll_y - (double)_scroll_y_set;
+    }
+    if (_scroll_to_row != M_MAX_UNSIGNED)
+    {
+        scroll = GetRowOffset(Min(_scroll_to_row, row_count), row_step);
+        _scroll_to_row = M_MAX_UNSIGNED;
+    }
+    else if (_follow_tail && _at_tail && row_count > _row_count)
+        scroll = max_scroll;
+    // Offset left past the end when rows were removed would show an empty view.
+    scroll = Clamp(scroll, 0.0, max_scroll);
+    _row_count = row_count;
+    _first_visible = GetRowAt(scroll, row_count, row_step);
+    _anchor_row = _first_visible;
+    _anchor_offset = scroll - GetRowOffset(_first_visible, row_step);
+
+    nk_layout_row_dynamic(ctx, height, 1);
+    // Scrollbar is handled when group ends, input of this frame decides how its offset change is read next frame.
+    struct nk_rect bounds = nk_widget_bounds(ctx);
+    float scrollbar = ctx->style.window.scrollbar_size.x * 2;
+    _scrollbar_dragged = nk_input_is_mouse_down(&ctx->input, NK_BUTTON_LEFT) &&
+                         nk_input_has_mouse_click_in_rect(&ctx->input, NK_BUTTON_LEFT,
+                             nk_rect(bounds.x + bounds.w - scrollbar, bounds.y, scrollbar, bounds.h));
+    _scroll_y = (nk_uint)(MapScroll(scroll, max_scroll, max_content_scroll, _view_height) + 0.5);
+    _scroll_y_set = _scroll_y;
+    if (!nk_group_scrolled_offset_begin(ctx, &_scroll_x, &_scroll_y, name, flags))
+    {
+        _visible_count = 0;
+        return false;
+    }
+
+    _view_height = nk_window_get_content_region(ctx).h;
+    unsigned end = Min(GetRowAt(scroll + _view_height, row_count, row_step) + 1, row_count);
+    _visible_count = end - _first_visible;
+
+    // Visible rows are placed relative to group offset instead of at their offsets, which may be too large for float
+    // positions to be exact.
+    double top = Max((double)_scroll_y_set - _anchor_offset, 0.0);
+    AddSpacer(ctx, (float)top);
+    double bottom = top;
+    for (unsigned row = _first_visible; row < end; row++)
+    {
+        float row_height = GetRowHeight(row, fixed_height);
+        draw_row(row, row_height);
+        bottom += row_height + spacing;
+    }
+    AddSpacer(ctx, (float)(content - bottom));
+
+    _at_tail = scroll >= max_scroll - row_step;
+    nk_group_scrolled_end(ctx);
+    return true;
+}
+
+float NuklearVirtualList::GetFixedRowHeight(nk_context* ctx) const
+{
+    if (_row_height > 0)
+        return _row_height;
+    return ctx->style.font->height + ctx->style.text.padding.y * 2;
+}
+
+void NuklearVirtualList::UpdateRowOffsets(unsigned row_count, float spacing)
+{
+    if (_row_offsets.Empty())
+        _row_offsets.Push(0);
+
+    if (spacing != _offsets_spacing)
+    {
+        _offsets_spacing = spacing;
+        for (unsigned i = 0; i < _row_heights.Size(); i++)
+            _row_offsets[i + 1] = _row_offsets[i] + _row_heights[i] + spacing;
+    }
+
+    if (_row_heights.Size() > row_count)
+        InvalidateRowHeights(row_count);
+
+    // Measuring continues from the last measured row. Rows in view are measured too when they are close enough, so
+    // that jumping far ahead does not measure every row in between.
+    unsigned measured = _row_heights.Size();
+    unsigned target = (_anchor_row <= measured + MEASURE_ROWS_PER_FRAME ? Max(measured, _anchor_row) : measured) +
+                      MEASURE_ROWS_PER_FRAME;
+    target = Min(target, row_count);
+    for (unsigned i = measured; i < target; i++)
+    {
+        // Rows of zero height would be laid out with minimal row height by nuklear.
+        float height = Max(_height_callback(i), 1.0f);
+        _row_heights.Push(height);
+        _row_offsets.Push(_row_offsets.Back() + height + spacing);
+    }
+
+    if (_row_heights.Empty())
+        _estimated_step = 0;
+    else
+        _estimated_step = (float)(_row_offsets.Back() / _row_heights.Size());
+}
+
+double NuklearVirtualList::GetRowOffset(unsigned row, float row_step) const
+{
+    if (!_height_callback)
+        return (double)row * row_step;
+
+    unsigned measured = _row_heights.Size();
+    if (row <= measured)
+        return _row_offsets[row];
+    float step = _estimated_step > 0 ? _estimated_step : row_step;
+    return _row_offsets[measured] + (double)(row - measured) * step;
+}
+
+unsigned NuklearVirtualList::GetRowAt(double offset, unsigned row_count, float row_step) const
+{
+    if (row_count == 0)
+        return 0;
+
+    unsigned measured = _height_callback ? Min(_row_heights.Size(), row_count) : 0;
+    if (measured == 0 || offset >= _row_offsets[measured])
+    {
+        float step = _height_callback && _estimated_step > 0 ? _estimated_step : row_step;
+        double start = measured ? _row_offsets[measured] : 0.0;
+        return Min(measured + (unsigned)Max((offset - start) / step, 0.0), row_count - 1);
+    }
+
+    // Last measured row whose offset is not past requested one.
+    unsigned first = 0;
+    unsigned last = measured - 1;
+    while (first < last)
+    {
+        unsigned middle = first + (last - first + 1) / 2;
+        if (_row_offsets[middle] <= offset)
+            first = middle;
+        else
+            last = middle - 1;
+    }
+    return first;
+}
+
+float NuklearVirtualList::GetRowHeight(unsigned row, float fixed_height) const
+{
+    if (!_height_callback)
+        return fixed_height;
+    if (row < _row_heights.Size())
+        return _row_heights[row];
+    // Visible rows far past measured ones are measured every frame, their count is bounded by view height.
+    return Max(_height_callback(row), 1.0f);
+}
+
+NuklearVirtualTable::NuklearVirtualTable(float row_height)
+    : NuklearVirtualList(row_height)
+{
+}
+
+void NuklearVirtualTable::AddColumn(const String& title, float width)
+{
+    _column_titles.Push(title);
+    _column_widths.Push(width);
+}
+
+void NuklearVirtualTable::RemoveAllColumns()
+{
+    _column_titles.Clear();
+    _column_widths.Clear();
+}
+
+bool NuklearVirtualTable::Draw(nk_context* ctx, const char* name, float height, unsigned row_count,
+                               const NuklearCellCallback& draw_cell, nk_flags flags)
+{
+    int columns = (int)_column_widths.Size();
+    if (columns == 0)
+        return false;
+
+    float header_height = GetFixedRowHeight(ctx);
+    nk_layout_row(ctx, NK_DYNAMIC, header_height, columns, &_column_widths[0]);
+    for (const String& title : _column_titles)
+        nk_label(ctx, title.CString(), NK_TEXT_LEFT);
+
+    float rows_height = Max(height - header_height - ctx->style.window.spacing.y, 1.0f);
+    return DrawRows(ctx, name, rows_height, row_count, [&](unsigned row, float row_height) {
+        nk_layout_row(ctx, NK_DYNAMIC, row_height, columns, &_column_widths[0]);
+        for (int column = 0; column < columns; column++)
+            draw_cell(ctx, row, (unsigned)column);
+    }, flags);
+}
+
+}
@@ -0,0 +1,176 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Rokas Kupstys
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+
+#include <functional>
+#include <Atomic/Container/Str.h>
+#include <Atomic/Container/Vector.h>
+#include <Atomic/Math/MathDefs.h>
+#include "nuklear/nuklear.h"
+
+namespace Atomic
+{
+
+/// Draws widgets of one row. Row is laid out as a single dynamic column of row height before the call.
+typedef std::function<void(nk_context* ctx, unsigned row)> NuklearRowCallback;
+/// Draws exactly one widget of a table cell. Row is laid out with table columns before the first cell.
+typedef std::function<void(nk_context* ctx, unsigned row, unsigned column)> NuklearCellCallback;
+/// Returns height of a row.
+typedef std::function<float(unsigned row)> NuklearRowHeightCallback;
+
+//! Scrolled list that lays out only visible rows.
+/*!
+  Rows above and below the view are replaced by a single spacer each, so per-frame cost depends on number of visible
+  rows and not on row count. Rows have a fixed height, or heights returned by a callback. Variable heights are
+  measured lazily, a bounded number of rows per frame, and rows not measured yet are assumed to have average height.
+  Scroll position is kept as a row and offset into it, therefore rows appended at the end or refined height estimates
+  do not move rows in view. Lists taller than nuklear can position precisely with floats are mapped into a shorter
+  scroll range. Object keeps scroll state and must live as long as the list is displayed.
+*/
+class NuklearVirtualList
+{
+public:
+    /// Construct with fixed row height. 0 uses height of current font.
+    explicit NuklearVirtualList(float row_height = 0);
+
+    /// Set fixed row height. 0 uses height of current font. Disables variable row heights.
+    void SetRowHeight(float height);
+    /// Get fixed row height.
+    float GetRowHeight() const { return _row_height; }
+    //! Use variable row heights.
+    /*!
+      Returned heights are cached. Rows are measured from the first one, a limited number per frame, and visible rows
+      are measured as needed. Call InvalidateRowHeights() when already measured rows change.
+    */
+    void SetRowHeightCallback(const NuklearRowHeightCallback& callback);
+    /// Drop cached heights of rows starting with first one.
+    void InvalidateRowHeights(unsigned first = 0);
+    /// Keep view scrolled to the last row when rows are appended while it is scrolled to the bottom. Useful for logs.
+    void SetFollowTail(bool follow) { _follow_tail = follow; }
+    /// Return true if view follows appended rows.
+    bool IsFollowTail() const { return _follow_tail; }
+    /// Scroll so that row is at the top of view on next Draw().
+    void ScrollToRow(unsigned row) { _scroll_to_row = row; }
+    /// Get first row laid out by last Draw().
+    unsigned GetFirstVisibleRow() const { return _first_visible; }
+    /// Get number of rows laid out by last Draw().
+    unsigned GetVisibleRowCount() const { return _visible_count; }
+
+    //! Draw list in a scrolled group.
+    /*!
+      \param name name of the group, unique within current window.
+      \param height height of the list. List occupies a full row of current window.
+      \param row_count number of rows, may change between frames.
+      \param draw_row callback drawing visible rows.
+      \param flags window flags of the group.
+      \return false if list is not visible.
+    */
+    bool Draw(nk_context* ctx, const char* name, float height, unsigned row_count, const NuklearRowCallback& draw_row,
+              nk_flags flags = NK_WINDOW_BORDER);
+
+protected:
+    /// Begin scrolled group, call draw_row with index and height of every visible row and end the group.
+    bool DrawRows(nk_context* ctx, const char* name, float height, unsigned row_count,
+                  const std::function<void(unsigned row, float row_height)>& draw_row, nk_flags flags);
+    /// Return height of fixed size rows.
+    float GetFixedRowHeight(nk_context* ctx) const;
+    /// Measure a limited number of rows that were not measured yet and update offsets when item spacing changed.
+    void UpdateRowOffsets(unsigned row_count, float spacing);
+    /// Return distance from the top of first row to the top of row, including item spacing. Rows that were not
+    /// measured yet are estimated.
+    double GetRowOffset(unsigned row, float row_step) const;
+    /// Return index of row at distance from the top.
+    unsigned GetRowAt(double offset, unsigned row_count, float row_step) const;
+    /// Return height row is laid out with.
+    float GetRowHeight(unsigned row, float fixed_height) const;
+
+    /// Fixed row height, 0 for font height.
+    float _row_height;
+    /// Variable row height callback.
+    NuklearRowHeightCallback _height_callback;
+    /// Measured heights of rows from the first one.
+    Atomic::PODVector<float> _row_heights;
+    /// Offsets of measured rows followed by offset of the end of last measured row.
+    Atomic::PODVector<double> _row_offsets;
+    /// Estimated step of rows that were not measured yet, including item spacing.
+    float _estimated_step = 0;
+    /// Item spacing offsets were computed with.
+    float _offsets_spacing = 0;
+    /// Scroll position, row at the top of view and distance of view top from the top of this row.
+    unsigned _anchor_row = 0;
+    double _anchor_offset = 0;
+    /// Scroll offsets of nuklear group, in scaled space of tall lists.
+    nk_uint _scroll_x = 0;
+    nk_uint _scroll_y = 0;
+    /// Vertical offset group began with, changes made by nuklear are applied next frame.
+    nk_uint _scroll_y_set = 0;
+    /// Scrollbar was dragged in last frame, group offset is then an absolute position.
+    bool _scrollbar_dragged = false;
+    /// Height of group content region in last frame.
+    float _view_height = 0;
+    unsigned _row_count = 0;
+    unsigned _scroll_to_row = M_MAX_UNSIGNED;
+    bool _follow_tail = false;
+    bool _at_tail = true;
+    unsigned _first_visible = 0;
+    unsigned _visible_count = 0;
+};
+
+//! Virtualized list with columns and a header.
+/*!
+  Header stays above scrolled rows. Columns are sized as ratios of table width, like nk_layout_row() with NK_DYNAMIC.
+*/
+class NuklearVirtualTable
+    : public NuklearVirtualList
+{
+public:
+    /// Construct with fixed row height. 0 uses height of current font.
+    explicit NuklearVirtualTable(float row_height = 0);
+
+    /// Add column with header title and width as a fraction of table width.
+    void AddColumn(const Atomic::String& title, float width);
+    /// Remove all columns.
+    void RemoveAllColumns();
+    /// Get number of columns.
+    unsigned GetNumColumns() const { return _column_widths.Size(); }
+
+    //! Draw header and rows in a scrolled group.
+    /*!
+      \param name name of the group, unique within current window.
+      \param height height of the table including header. Table occupies full rows of current window.
+      \param row_count number of rows, may change between frames.
+      \param draw_cell callback drawing cells of visible rows.
+      \param flags window flags of the group.
+      \return false if table is not visible.
+    */
+    bool Draw(nk_context* ctx, const char* name, float height, unsigned row_count, const NuklearCellCallback& draw_cell,
+              nk_flags flags = NK_WINDOW_BORDER);
+
+protected:
+    Atomic::Vector<Atomic::String> _column_titles;
+    Atomic::PODVector<float> _column_widths;
+};
+
+}
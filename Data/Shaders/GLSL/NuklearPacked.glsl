@@ -0,0 +1,37 @@
+// Vertex shader for packed NuklearUI vertices. Pixel shaders of Basic are used with it.
+#include "Uniforms.glsl"
+
+// Must match PACKED_POSITION_ORIGIN and PACKED_POSITION_SCALE in AtomicNuklearUI.cpp.
+#define PACKED_POSITION_ORIGIN 1024.0
+#define PACKED_POSITION_SCALE 8.0
+
+#if defined(DIFFMAP) || defined(ALPHAMAP)
+    varying vec2 vTexCoord;
+#endif
+#ifdef VERTEXCOLOR
+    varying vec4 vColor;
+#endif
+
+#ifdef COMPILEVS
+// Position and texture coordinates are pairs of little endian 16-bit values read as unnormalized bytes.
+attribute vec4 iPos;
+attribute vec4 iTexCoord;
+attribute vec4 iColor;
+
+vec2 UnpackShort2(vec4 bytes)
+{
+    return vec2(bytes.x + bytes.y * 256.0, bytes.z + bytes.w * 256.0);
+}
+
+void VS()
+{
+    vec2 pos = UnpackShort2(iPos) / PACKED_POSITION_SCALE - PACKED_POSITION_ORIGIN;
+    gl_Position = vec4(pos, 0.0, 1.0) * cViewProj;
+    #if defined(DIFFMAP) || defined(ALPHAMAP)
+        vTexCoord = UnpackShort2(iTexCoord) / 65535.0;
+    #endif
+    #ifdef VERTEXCOLOR
+        vColor = iColor;
+    #endif
+}
+#endif
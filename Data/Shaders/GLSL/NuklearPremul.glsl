@@ -0,0 +1,33 @@
+// Pixel shader writing premultiplied alpha, used when NuklearUI renders windows into textures. Vertex shaders of
+// Basic and NuklearPacked are used with it.
+#include "Uniforms.glsl"
+#include "Samplers.glsl"
+#include "Transform.glsl"
+
+#if defined(DIFFMAP) || defined(ALPHAMAP)
+    varying vec2 vTexCoord;
+#endif
+#ifdef VERTEXCOLOR
+    varying vec4 vColor;
+#endif
+
+#ifdef COMPILEPS
+void PS()
+{
+    vec4 diffColor = cMatDiffColor;
+    #ifdef VERTEXCOLOR
+        diffColor *= vColor;
+    #endif
+    #ifdef DIFFMAP
+        diffColor *= texture2D(sDiffMap, vTexCoord);
+    #endif
+    #ifdef ALPHAMAP
+        #ifdef GL3
+            diffColor.a *= texture2D(sDiffMap, vTexCoord).r;
+        #else
+            diffColor.a *= texture2D(sDiffMap, vTexCoord).a;
+        #endif
+    #endif
+    gl_FragColor = vec4(diffColor.rgb * diffColor.a, diffColor.a);
+}
+#endif
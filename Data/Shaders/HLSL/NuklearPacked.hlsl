@@ -0,0 +1,44 @@
+// Vertex shader for packed NuklearUI vertices. Pixel shaders of Basic are used with it.
+#include "Uniforms.hlsl"
+#include "Transform.hlsl"
+
+// Must match PACKED_POSITION_ORIGIN and PACKED_POSITION_SCALE in AtomicNuklearUI.cpp.
+static const float PACKED_POSITION_ORIGIN = 1024.0;
+static const float PACKED_POSITION_SCALE = 8.0;
+
+// Position and texture coordinates are pairs of little endian 16-bit values read as unnormalized bytes.
+#ifdef D3D11
+    #define PackedBytes uint4
+#else
+    #define PackedBytes float4
+#endif
+
+float2 UnpackShort2(float4 bytes)
+{
+    return float2(bytes.x + bytes.y * 256.0, bytes.z + bytes.w * 256.0);
+}
+
+void VS(PackedBytes iPos : POSITION,
+    #if defined(DIFFMAP) || defined(ALPHAMAP)
+        PackedBytes iTexCoord : TEXCOORD0,
+    #endif
+    #ifdef VERTEXCOLOR
+        float4 iColor : COLOR0,
+    #endif
+    #if defined(DIFFMAP) || defined(ALPHAMAP)
+        out float2 oTexCoord : TEXCOORD0,
+    #endif
+    #ifdef VERTEXCOLOR
+        out float4 oColor : COLOR0,
+    #endif
+    out float4 oPos : OUTPOSITION)
+{
+    float2 pos = UnpackShort2(iPos) / PACKED_POSITION_SCALE - PACKED_POSITION_ORIGIN;
+    oPos = GetClipPos(float3(pos, 0.0));
+    #if defined(DIFFMAP) || defined(ALPHAMAP)
+        oTexCoord = UnpackShort2(iTexCoord) / 65535.0;
+    #endif
+    #ifdef VERTEXCOLOR
+        oColor = iColor;
+    #endif
+}
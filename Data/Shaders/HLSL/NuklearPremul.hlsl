@@ -0,0 +1,27 @@
+// Pixel shader writing premultiplied alpha, used when NuklearUI renders windows into textures. Vertex shaders of
+// Basic and NuklearPacked are used with it.
+#include "Uniforms.hlsl"
+#include "Samplers.hlsl"
+#include "Transform.hlsl"
+
+void PS(
+    #if defined(DIFFMAP) || defined(ALPHAMAP)
+        float2 iTexCoord : TEXCOORD0,
+    #endif
+    #ifdef VERTEXCOLOR
+        float4 iColor : COLOR0,
+    #endif
+    out float4 oColor : OUTCOLOR0)
+{
+    float4 diffColor = cMatDiffColor;
+    #ifdef VERTEXCOLOR
+        diffColor *= iColor;
+    #endif
+    #ifdef DIFFMAP
+        diffColor *= Sample2D(DiffMap, iTexCoord);
+    #endif
+    #ifdef ALPHAMAP
+        diffColor.a *= Sample2D(DiffMap, iTexCoord).a;
+    #endif
+    oColor = float4(diffColor.rgb * diffColor.a, diffColor.a);
+}
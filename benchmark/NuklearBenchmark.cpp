@@ -0,0 +1,442 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Rokas Kupstys
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Headless benchmark of NuklearUI frame pipeline. Builds synthetic UI scenes and reports per-stage timings and geometry
+// counts. Timings can be compared against a stored baseline, process exits with non-zero code on regression.
+#include <cstdio>
+#include <cmath>
+#include <SDL.h>
+#include <Atomic/Core/Context.h>
+#include <Atomic/Core/ProcessUtils.h>
+#include <Atomic/Core/Timer.h>
+#include <Atomic/Graphics/Graphics.h>
+#include <Atomic/Input/InputEvents.h>
+#include <Atomic/IO/File.h>
+#include <Atomic/IO/FileSystem.h>
+#include <Atomic/IO/Log.h>
+#include <Atomic/Resource/ResourceCache.h>
+#include "AtomicNuklearUI.h"
+#include "AtomicNuklearWidgets.h"
+
+using namespace Atomic;
+
+namespace
+{
+
+typedef void (*SceneBuilder)(nk_context* ctx, unsigned frame);
+
+struct Scene
+{
+    const char* name;
+    SceneBuilder build;
+    /// Commands of odd frames repeat the previous frame, so at most half of the frames may hit frame cache.
+    bool repeats_odd_frames;
+};
+
+/// Averaged results of a scene run.
+struct SceneResult
+{
+    double input_us = 0;
+    double layout_us = 0;
+    double convert_us = 0;
+    double drawlist_us = 0;
+    double submit_us = 0;
+    double vertices = 0;
+    double indices = 0;
+    double commands = 0;
+    double draw_calls = 0;
+    /// Frames whose geometry was reused by frame cache. Not averaged.
+    unsigned frame_cache_hits = 0;
+    /// Frames that may hit frame cache because their commands repeat the previous frame.
+    unsigned repeated_frames = 0;
+};
+
+/// Names of averaged SceneResult fields, in order.
+const char* metric_names[] = {
+    "input_us", "layout_us", "convert_us", "drawlist_us", "submit_us", "vertices", "indices", "commands", "draw_calls"
+};
+const unsigned NUM_METRICS = sizeof(metric_names) / sizeof(metric_names[0]);
+
+void BuildList(nk_context* ctx, unsigned frame)
+{
+    if (nk_begin(ctx, "List", nk_rect(0, 0, 480, 1000), NK_WINDOW_BORDER | NK_WINDOW_TITLE))
+    {
+        char row[64];
+        nk_layout_row_dynamic(ctx, 18, 1);
+        for (unsigned i = 0; i < 10000; i++)
+        {
+            snprintf(row, sizeof(row), "Row %u: value %u", i, (i * 7919 + frame) % 1000);
+            nk_label(ctx, row, NK_TEXT_LEFT);
+        }
+    }
+    nk_end(ctx);
+}
+
+void BuildVirtualList(nk_context* ctx, unsigned frame)
+{
+    static NuklearVirtualList list(18);
+    if (nk_begin(ctx, "Virtual list", nk_rect(0, 0, 480, 1000), NK_WINDOW_BORDER | NK_WINDOW_TITLE))
+    {
+        // Scrolls through the list at a fixed pace, rows are formatted only when visible.
+        if (frame % 16 == 0)
+            list.ScrollToRow(frame * 997 % 1000000);
+        list.Draw(ctx, "rows", 950, 1000000, [frame](nk_context* ctx, unsigned i) {
+            char row[64];
+            snprintf(row, sizeof(row), "Row %u: value %u", i, (i * 7919 + frame) % 1000);
+            nk_label(ctx, row, NK_TEXT_LEFT);
+        });
+    }
+    nk_end(ctx);
+}
+
+void BuildPropertyGrid(nk_context* ctx, unsigned frame)
+{
+    static float values[400];
+    static int enabled[400];
+    if (nk_begin(ctx, "Properties", nk_rect(500, 0, 600, 1000), NK_WINDOW_BORDER | NK_WINDOW_TITLE))
+    {
+        char name[32];
+        for (unsigned i = 0; i < 400; i++)
+        {
+            nk_layout_row_dynamic(ctx, 22, 3);
+            snprintf(name, sizeof(name), "Property %u", i);
+            nk_label(ctx, name, NK_TEXT_LEFT);
+            nk_property_float(ctx, "#x", -1000.0f, &values[i], 1000.0f, 0.1f, 0.01f);
+            nk_checkbox_label(ctx, "on", &enabled[i]);
+        }
+    }
+    nk_end(ctx);
+}
+
+void BuildCharts(nk_context* ctx, unsigned frame)
+{
+    char title[32];
+    for (unsigned w = 0; w < 12; w++)
+    {
+        snprintf(title, sizeof(title), "Chart %u", w);
+        float x = (float)(w % 4) * 300;
+        float y = (float)(w / 4) * 330;
+        if (nk_begin(ctx, title, nk_rect(x, y, 300, 330), NK_WINDOW_BORDER | NK_WINDOW_TITLE))
+        {
+            nk_layout_row_dynamic(ctx, 120, 1);
+            if (nk_chart_begin(ctx, NK_CHART_LINES, 256, -1.0f, 1.0f))
+            {
+                for (unsigned i = 0; i < 256; i++)
+                    nk_chart_push(ctx, sinf((i + frame + w * 10) * 0.05f));
+                nk_chart_end(ctx);
+            }
+
+            nk_layout_row_dynamic(ctx, 150, 1);
+            struct nk_rect bounds;
+            if (nk_widget(&bounds, ctx))
+            {
+                struct nk_command_buffer* canvas = nk_window_get_canvas(ctx);
+                for (unsigned i = 0; i < 48; i++)
+                {
+                    float phase = (i + frame) * 0.1f;
+                    nk_stroke_curve(canvas, bounds.x, bounds.y + bounds.h * 0.5f,
+                                    bounds.x + bounds.w * 0.3f, bounds.y + bounds.h * (0.5f + 0.5f * sinf(phase)),
+                                    bounds.x + bounds.w * 0.6f, bounds.y + bounds.h * (0.5f - 0.5f * cosf(phase)),
+                                    bounds.x + bounds.w, bounds.y + bounds.h * 0.5f, 1.5f, nk_rgb(200, 100 + i, 50));
+                    nk_fill_circle(canvas, nk_rect(bounds.x + i * 5.0f, bounds.y + 4, 6, 6), nk_rgb(50, 200, 100));
+                }
+            }
+        }
+        nk_end(ctx);
+    }
+}
+
+void BuildText(nk_context* ctx, unsigned frame)
+{
+    static const char* text = "The quick brown fox jumps over the lazy dog. Sphinx of black quartz, judge my vow! "
+        "Pack my box with five dozen liquor jugs. 0123456789 (){}[]<>+-*/=";
+    if (nk_begin(ctx, "Text", nk_rect(0, 0, 1200, 1000), NK_WINDOW_BORDER | NK_WINDOW_TITLE))
+    {
+        for (unsigned i = 0; i < 120; i++)
+        {
+            nk_layout_row_dynamic(ctx, 40, 1);
+            nk_label_colored_wrap(ctx, text, nk_rgb(255, 255 - (i + frame) % 128, 200));
+        }
+    }
+    nk_end(ctx);
+}
+
+void BuildStaticWindows(nk_context* ctx, unsigned frame)
+{
+    // Small windows keep more state in back of fixed context memory than commands in front of it. Only the last
+    // label changes, every other frame.
+    char text[32];
+    for (unsigned w = 0; w < 16; w++)
+    {
+        snprintf(text, sizeof(text), "Static %u", w);
+        float x = (float)(w % 4) * 150;
+        float y = (float)(w / 4) * 60;
+        if (nk_begin(ctx, text, nk_rect(x, y, 140, 50), NK_WINDOW_NO_INPUT | NK_WINDOW_NO_SCROLLBAR))
+        {
+            nk_layout_row_dynamic(ctx, 18, 1);
+            if (w == 15)
+                snprintf(text, sizeof(text), "Frame %u", frame / 2);
+            nk_label(ctx, text, NK_TEXT_LEFT);
+        }
+        nk_end(ctx);
+    }
+}
+
+const Scene scenes[] = {
+    {"list", &BuildList, false},
+    {"virtual_list", &BuildVirtualList, false},
+    {"property_grid", &BuildPropertyGrid, false},
+    {"charts", &BuildCharts, false},
+    {"text", &BuildText, false},
+    {"static_windows", &BuildStaticWindows, true},
+};
+
+void SendRawInput(NuklearUI* nuklear, SDL_Event& evt)
+{
+    using namespace SDLRawInput;
+    VariantMap& args = nuklear->GetEventDataMap();
+    args[P_SDLEVENT] = &evt;
+    args[P_CONSUMED] = false;
+    nuklear->SendEvent(E_SDLRAWINPUT, args);
+}
+
+void SimulateInput(NuklearUI* nuklear, unsigned frame)
+{
+    // Raw SDL events are sent the way Input sends them, so coalescing and recording are measured too. Mouse sweeps over
+    // the screen reporting motion several times per frame, like high rate mice do, and scrolls every few frames.
+    static const unsigned MOTION_EVENTS = 4;
+    nuklear->SendEvent(E_INPUTBEGIN);
+    SDL_Event evt;
+    for (unsigned i = 0; i < MOTION_EVENTS; i++)
+    {
+        SDL_zero(evt);
+        evt.type = SDL_MOUSEMOTION;
+        evt.motion.x = (int)((frame * MOTION_EVENTS + i) * 7 / MOTION_EVENTS % 1200);
+        evt.motion.y = (int)((frame * MOTION_EVENTS + i) * 3 / MOTION_EVENTS % 1000);
+        SendRawInput(nuklear, evt);
+    }
+    if (frame % 4 == 0)
+    {
+        SDL_zero(evt);
+        evt.type = SDL_MOUSEWHEEL;
+        evt.wheel.y = frame % 8 == 0 ? -1 : 1;
+        SendRawInput(nuklear, evt);
+    }
+    nuklear->SendEvent(E_INPUTEND);
+}
+
+SceneResult RunScene(NuklearUI* nuklear, const Scene& scene, unsigned warmup, unsigned frames)
+{
+    SceneResult result;
+    nk_context* ctx = nuklear->GetNkContext();
+    HiresTimer timer;
+    unsigned cache_hits = 0;
+    for (unsigned frame = 0; frame < warmup + frames; frame++)
+    {
+        timer.Reset();
+        if (nuklear->IsReplayingInput())
+            nuklear->ReplayInputFrame();
+        else
+            SimulateInput(nuklear, frame);
+        long long input_us = timer.GetUSec(true);
+        scene.build(ctx, frame);
+        long long layout_us = timer.GetUSec(true);
+        nuklear->Render();
+
+        const NuklearUIStats& stats = nuklear->GetStats();
+        bool cache_hit = stats.frame_cache_hits != cache_hits;
+        cache_hits = stats.frame_cache_hits;
+        if (frame < warmup)
+            continue;
+
+        if (cache_hit)
+            result.frame_cache_hits++;
+        if (scene.repeats_odd_frames && frame % 2 == 1)
+            result.repeated_frames++;
+        result.input_us += input_us;
+        result.layout_us += layout_us;
+        result.convert_us += stats.convert_time_us;
+        result.drawlist_us += stats.record_time_us;
+        result.submit_us += stats.submit_time_us;
+        result.vertices += stats.vertex_count;
+        result.indices += stats.index_count;
+        result.commands += stats.nk_draw_commands;
+        result.draw_calls += stats.draw_calls;
+    }
+
+    double* values = &result.input_us;
+    for (unsigned i = 0; i < NUM_METRICS; i++)
+        values[i] /= frames;
+    return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    const Vector<String>& arguments = ParseArguments(argc, argv);
+    unsigned frames = 300;
+    unsigned warmup = 30;
+    float tolerance = 0.1f;
+    String only_scene;
+    String baseline_path;
+    String save_baseline_path;
+    String font_path;
+    String resource_dir;
+    String replay_path;
+    String record_path;
+    NuklearMemoryConfig memory;
+    bool frame_cache = false;
+    bool coalesce = false;
+    for (unsigned i = 0; i < arguments.Size(); i++)
+    {
+        const String& arg = arguments[i];
+        bool has_value = i + 1 < arguments.Size();
+        if (arg == "--frames" && has_value)
+            frames = Max(ToUInt(arguments[++i]), 1u);
+        else if (arg == "--warmup" && has_value)
+            warmup = ToUInt(arguments[++i]);
+        else if (arg == "--tolerance" && has_value)
+            tolerance = ToFloat(arguments[++i]);
+        else if (arg == "--scene" && has_value)
+            only_scene = arguments[++i];
+        else if (arg == "--baseline" && has_value)
+            baseline_path = arguments[++i];
+        else if (arg == "--save-baseline" && has_value)
+            save_baseline_path = arguments[++i];
+        else if (arg == "--font" && has_value)
+            font_path = arguments[++i];
+        else if (arg == "--resources" && has_value)
+            resource_dir = arguments[++i];
+        else if (arg == "--replay" && has_value)
+            replay_path = arguments[++i];
+        else if (arg == "--frame-budget" && has_value)
+            memory.frame_budget = ToUInt(arguments[++i]);
+        else if (arg == "--frame-cache")
+            frame_cache = true;
+        else if (arg == "--coalesce")
+            coalesce = true;
+        else if (arg == "--record" && has_value)
+            record_path = arguments[++i];
+        else
+        {
+            PrintLine("Usage: AtomicNuklearUIBenchmark [--frames N] [--warmup N] [--scene name] [--baseline file] "
+                      "[--save-baseline file] [--tolerance fraction] [--resources dir --font ttf] [--replay file] "
+                      "[--frame-budget bytes] [--frame-cache] [--coalesce] [--record file]", true);
+            return 2;
+        }
+    }
+
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new Time(context));
+    context->RegisterSubsystem(new FileSystem(context));
+    context->RegisterSubsystem(new Log(context));
+    context->RegisterSubsystem(new ResourceCache(context));
+    RegisterResourceLibrary(context);
+    RegisterGraphicsLibrary(context);
+    context->GetSubsystem<Log>()->SetLevel(LOG_WARNING);
+    if (!resource_dir.Empty())
+        context->GetSubsystem<ResourceCache>()->AddResourceDir(resource_dir);
+
+    SharedPtr<NuklearUI> nuklear(new NuklearUI(context, memory));
+    nuklear->SetFrameCacheEnabled(frame_cache);
+    nuklear->SetInputCoalescing(coalesce);
+    if (!record_path.Empty() && !nuklear->StartInputRecording(record_path))
+    {
+        PrintLine("Can not open recording " + record_path, true);
+        return 2;
+    }
+    nuklear->BeginAddFonts();
+    nuklear->AddDefaultFont();
+    if (!font_path.Empty())
+        nuklear->AddFont(font_path, 0, {0x0020, 0x00FF, 0x0370, 0x03FF, 0x0400, 0x04FF, 0}, NKUI_FONT_MERGE);
+    nuklear->EndAddFonts();
+
+    HashMap<String, float> baseline;
+    if (!baseline_path.Empty())
+    {
+        File file(context, baseline_path, FILE_READ);
+        if (!file.IsOpen())
+        {
+            PrintLine("Can not open baseline " + baseline_path, true);
+            return 2;
+        }
+        while (!file.IsEof())
+        {
+            Vector<String> parts = file.ReadLine().Split(' ');
+            if (parts.Size() == 2)
+                baseline[parts[0]] = ToFloat(parts[1]);
+        }
+    }
+
+    String saved;
+    bool regressed = false;
+    PrintLine(ToString("%-16s %10s %10s %10s %11s %10s %10s %10s %9s %6s", "scene", "input_us", "layout_us",
+                       "convert_us", "drawlist_us", "submit_us", "vertices", "indices", "commands", "draws"));
+    for (const Scene& scene : scenes)
+    {
+        if (!only_scene.Empty() && only_scene != scene.name)
+            continue;
+
+        // Every scene replays recording from its start, looping when it is shorter than benchmark.
+        if (!replay_path.Empty() && !nuklear->StartInputReplay(replay_path, true))
+            return 2;
+        SceneResult result = RunScene(nuklear, scene, warmup, frames);
+        PrintLine(ToString("%-16s %10.1f %10.1f %10.1f %11.1f %10.1f %10.0f %10.0f %9.0f %6.0f", scene.name,
+                           result.input_us, result.layout_us, result.convert_us, result.drawlist_us, result.submit_us,
+                           result.vertices, result.indices, result.commands, result.draw_calls));
+
+        // Frame cache must not reuse geometry of a frame whose commands changed.
+        if (frame_cache && replay_path.Empty() && result.frame_cache_hits > result.repeated_frames)
+        {
+            PrintLine(ToString("STALE FRAME %s: %u frame cache hits, %u repeated frames", scene.name,
+                               result.frame_cache_hits, result.repeated_frames), true);
+            regressed = true;
+        }
+
+        const double* values = &result.input_us;
+        for (unsigned i = 0; i < NUM_METRICS; i++)
+        {
+            String key = String(scene.name) + "." + metric_names[i];
+            saved += key + ToString(" %f\n", values[i]);
+
+            auto it = baseline.Find(key);
+            // Sub-microsecond stages are dominated by timer noise.
+            if (it == baseline.End() || values[i] < 1.0)
+                continue;
+            if (values[i] > it->second_ * (1.0f + tolerance))
+            {
+                PrintLine(ToString("REGRESSION %s: %.1f, baseline %.1f", key.CString(), values[i], it->second_), true);
+                regressed = true;
+            }
+        }
+    }
+
+    if (!save_baseline_path.Empty())
+    {
+        File file(context, save_baseline_path, FILE_WRITE);
+        file.Write(saved.CString(), saved.Length());
+    }
+
+    return regressed ? 1 : 0;
+}